@@ -28,6 +28,7 @@
 #include <linux/etherdevice.h>
 #include <linux/socket.h>
 #include <linux/jiffies.h>
+#include <linux/net_tstamp.h>
 #include <net/ipv6.h>
 #include <net/ip6_checksum.h>
 #include <net/udp.h>
@@ -41,10 +42,30 @@
 #endif /* __TC_MQPRIO_MODE_MAX */
 
 #include "kcompat.h"
+#ifdef HAVE_XDP_SUPPORT
+#include <linux/bpf_trace.h>
+#endif /* HAVE_XDP_SUPPORT */
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+#include <net/xdp_sock_drv.h>
+#else
+#include <net/xdp_sock.h>
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+#ifdef HAVE_PAGE_POOL
+#include <net/page_pool.h>
+#endif /* HAVE_PAGE_POOL */
+#ifdef HAVE_DIM
+#include <linux/dim.h>
+#endif /* HAVE_DIM */
+#ifdef HAVE_HK_FLAG_MANAGED_IRQ
+#include <linux/sched/isolation.h>
+#endif /* HAVE_HK_FLAG_MANAGED_IRQ */
 
 #include "iavf_type.h"
 #include "virtchnl.h"
 #include "iavf_txrx.h"
+#include "iavf_xsk.h"
 #include <linux/bitmap.h>
 
 #define DEFAULT_DEBUG_LEVEL_SHIFT 3
@@ -66,8 +87,17 @@ struct iavf_vsi {
 #else
 	unsigned long active_vlans[BITS_TO_LONGS(VLAN_N_VID)];
 #endif
-	/* dummy pointer - VF plans to add this functionality in the future */
+	/* XDP Tx rings, indexed by the Rx queue they transmit for */
 	struct iavf_ring **xdp_rings;
+	/* ndo_xdp_xmit rings, indexed by CPU modulo their number */
+	struct iavf_ring **xdp_xmit_rings;
+	struct bpf_prog *xdp_prog;
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	/* AF_XDP zero-copy buffer pools, indexed by queue id */
+	struct xsk_buff_pool **xsk_pools;
+	u16 num_xsk_pools_used;
+	u16 num_xsk_pools;
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 	u16 seid;
 	u16 id;
 	DECLARE_BITMAP(state, __IAVF_VSI_STATE_SIZE__);
@@ -79,12 +109,20 @@ struct iavf_vsi {
 
 /* How many Rx Buffers do we bundle into one write to the hardware ? */
 #define IAVF_RX_BUFFER_WRITE	16	/* Must be power of 2 */
+#define IAVF_RX_BUFFER_WRITE_MAX 64	/* ceiling of the adaptive watermark */
+#define IAVF_RX_BULK_ALLOC	16	/* pages requested per bulk alloc */
+#define IAVF_RX_SCAN_BATCH	8	/* descriptors checked at once */
 #define IAVF_DEFAULT_TXD	512
 #define IAVF_DEFAULT_RXD	512
 #define IAVF_MAX_TXD		4096
 #define IAVF_MIN_TXD		64
 #define IAVF_MAX_RXD		4096
 #define IAVF_MIN_RXD		64
+#define IAVF_DEFAULT_RX_COPYBREAK	0	/* disabled */
+#define IAVF_MAX_RX_COPYBREAK	IAVF_RX_HDR_SIZE
+#define IAVF_TX_BOUNCE_SLOT	256	/* bytes per Tx bounce buffer */
+#define IAVF_DEFAULT_TX_COPYBREAK	0	/* disabled */
+#define IAVF_MAX_TX_COPYBREAK	IAVF_TX_BOUNCE_SLOT
 #define IAVF_REQ_DESCRIPTOR_MULTIPLE	32
 #define IAVF_MAX_AQ_BUF_SIZE	4096
 #define IAVF_AQ_LEN		32
@@ -92,7 +130,16 @@ struct iavf_vsi {
 
 #define MAXIMUM_ETHERNET_VLAN_SIZE (VLAN_ETH_FRAME_LEN + ETH_FCS_LEN)
 
-#define IAVF_RX_DESC(R, i) (&(((union iavf_32byte_rx_desc *)((R)->desc))[i]))
+#define IAVF_RX_DESC_32B(R, i) \
+	(&(((union iavf_32byte_rx_desc *)((R)->desc))[i]))
+/* a 16-byte descriptor has the layout of the first half of a 32-byte one,
+ * so it is accessed through the same type as long as only qword0 and qword1
+ * are touched
+ */
+#define IAVF_RX_DESC_16B(R, i) ((union iavf_32byte_rx_desc *) \
+	(&(((union iavf_16byte_rx_desc *)((R)->desc))[i])))
+#define IAVF_RX_DESC(R, i) (ring_uses_16byte_desc(R) ? \
+			    IAVF_RX_DESC_16B(R, i) : IAVF_RX_DESC_32B(R, i))
 #define IAVF_TX_DESC(R, i) (&(((struct iavf_tx_desc *)((R)->desc))[i]))
 #define IAVF_TX_CTXTDESC(R, i) \
 	(&(((struct iavf_tx_context_desc *)((R)->desc))[i]))
@@ -131,6 +178,7 @@ struct iavf_q_vector_ch_stats {
 	 */
 	u64 in_bp;
 	u64 in_intr;
+	u64 in_threaded;	/* in_intr polls run by the NAPI kthread */
 	u64 intr_to_bp;
 	u64 bp_to_intr;
 	u64 intr_to_intr;
@@ -173,6 +221,14 @@ struct iavf_q_vector_ch_stats {
 	u64 intr_en_not_clean_complete;
 };
 
+/* interrupt moderation decisions, to compare the ITR engines */
+struct iavf_q_vector_itr_stats {
+	u64 rx_itr_updates;	/* Rx ITR written to the register */
+	u64 tx_itr_updates;	/* Tx ITR written to the register */
+	u64 rx_dim_moves;	/* Rx profile changes made by DIM */
+	u64 tx_dim_moves;	/* Tx profile changes made by DIM */
+};
+
 /* MAX_MSIX_Q_VECTORS of these are allocated,
  * but we only use one per queue-specific vector.
  */
@@ -184,9 +240,14 @@ struct iavf_q_vector {
 	struct iavf_ring_container tx;
 	u32 ring_mask;
 	u8 itr_countdown;	/* when 0 should adjust adaptive ITR */
+#ifdef HAVE_DIM
+	u16 total_events;	/* interrupts sampled by DIM */
+#endif /* HAVE_DIM */
 	u8 num_ringpairs;	/* total number of ring pairs in vector */
+	struct iavf_ring *rx_drr_next;	/* Rx ring to poll first, if set */
 	u16 v_idx;		/* index in the vsi->q_vector array. */
 	u16 reg_idx;		/* register index of the interrupt */
+	int numa_node;		/* node of the CPU servicing the vector */
 	char name[IFNAMSIZ + 15];
 	bool arm_wb_state;
 #ifdef HAVE_IRQ_AFFINITY_NOTIFY
@@ -224,8 +285,21 @@ struct iavf_q_vector {
 
 	struct iavf_channel_ex *ch;
 	struct iavf_q_vector_ch_stats ch_stats;
+	struct iavf_q_vector_itr_stats itr_stats;
 };
 
+/**
+ * iavf_ring_node - NUMA node to allocate a ring's memory on
+ * @ring: ring to check
+ *
+ * Returns the node of the CPU servicing the ring's vector, or NUMA_NO_NODE
+ * if the ring isn't mapped to a vector.
+ **/
+static inline int iavf_ring_node(struct iavf_ring *ring)
+{
+	return ring->q_vector ? ring->q_vector->numa_node : NUMA_NO_NODE;
+}
+
 static inline bool vector_pkt_inspect_opt_ena(struct iavf_q_vector *q_vector)
 {
 	return q_vector->chnl_flags & IAVF_VECTOR_CHNL_PKT_OPT_ENA;
@@ -468,16 +542,20 @@ struct iavf_adapter {
 	char misc_vector_name[IFNAMSIZ + 9];
 	int num_active_queues;
 	int num_req_queues;
+	int num_xdp_queues;
+	int num_xdp_xmit_queues;
 
 	/* TX */
 	struct iavf_ring *tx_rings;
 	u32 tx_timeout_count;
 	u32 tx_desc_count;
+	u32 tx_copybreak;
 
 	/* RX */
 	struct iavf_ring *rx_rings;
 	u64 hw_csum_rx_error;
 	u32 rx_desc_count;
+	u32 rx_copybreak;
 	int num_msix_vectors;
 	int num_iwarp_msix;
 	int iwarp_base_vector;
@@ -487,10 +565,14 @@ struct iavf_adapter {
 
 	u32 flags;
 #define IAVF_FLAG_RX_CSUM_ENABLED		BIT(0)
+#define IAVF_FLAG_TX_TSTAMP_COMPL		BIT(1)
+#define IAVF_FLAG_TX_FLOW_AFFINE		BIT(2)
 #define IAVF_FLAG_PF_COMMS_FAILED		BIT(3)
 #define IAVF_FLAG_RESET_PENDING			BIT(4)
 #define IAVF_FLAG_RESET_NEEDED			BIT(5)
 #define IAVF_FLAG_WB_ON_ITR_CAPABLE		BIT(6)
+#define IAVF_FLAG_XDP_REQ_QUEUES		BIT(7)
+#define IAVF_FLAG_TX_DB_COALESCE		BIT(8)
 #define IAVF_FLAG_SERVICE_CLIENT_REQUESTED	BIT(9)
 #define IAVF_FLAG_CLIENT_NEEDS_OPEN		BIT(10)
 #define IAVF_FLAG_CLIENT_NEEDS_CLOSE		BIT(11)
@@ -501,15 +583,33 @@ struct iavf_adapter {
 #define IAVF_FLAG_REINIT_ITR_NEEDED		BIT(16)
 #define IAVF_FLAG_QUEUES_ENABLED		BIT(17)
 #define IAVF_FLAG_QUEUES_DISABLED		BIT(18)
+#define IAVF_FLAG_RX_PAGE_CACHE			BIT(19)
 #define IAVF_FLAG_REINIT_MSIX_NEEDED		BIT(20)
 #define IAVF_FLAG_REINIT_CHNL_NEEDED		BIT(21)
 #define IAVF_FLAG_RESET_DETECTED		BIT(22)
 #define IAVF_FLAG_CHNL_CFG_FAILED		BIT(23)
+#define IAVF_FLAG_RX_PAGE_POOL			BIT(24)
+#define IAVF_FLAG_RX_HDR_SPLIT			BIT(25)
+#define IAVF_FLAG_RX_DESC_16B			BIT(26)
+#define IAVF_FLAG_DIM_LATENCY			BIT(27)
+#define IAVF_FLAG_DIM_BALANCED			BIT(28)
+#define IAVF_FLAG_DIM_THROUGHPUT		BIT(29)
+#define IAVF_FLAG_DIM_MASK	(IAVF_FLAG_DIM_LATENCY | \
+				 IAVF_FLAG_DIM_BALANCED | \
+				 IAVF_FLAG_DIM_THROUGHPUT)
+#define IAVF_FLAG_NAPI_THREADED			BIT(30)
+#define IAVF_FLAG_TX_HEAD_WB			BIT(31)
 
 
 	u32 chnl_perf_flags;
 #define IAVF_FLAG_CHNL_PKT_OPT_ENA		BIT(0)
 
+	/* IRQ placement policies, applied whenever the IRQs are requested */
+	u32 irq_place_flags;
+#define IAVF_FLAG_IRQ_NUMA_LOCAL		BIT(0)
+#define IAVF_FLAG_IRQ_SKIP_SMT			BIT(1)
+#define IAVF_FLAG_IRQ_HOUSEKEEPING		BIT(2)
+
 /* duplicates for common code */
 #define IAVF_FLAG_DCB_ENABLED			0
 	/* flags for admin queue service task */
@@ -589,6 +689,8 @@ struct iavf_adapter {
 			  VIRTCHNL_VF_OFFLOAD_ADQ)
 #define ADQ_V2_ALLOWED(_a) ((_a)->vf_res->vf_cap_flags & \
 			  VIRTCHNL_VF_OFFLOAD_ADQ_V2)
+#define RXDID_ALLOWED(_a) ((_a)->vf_res->vf_cap_flags & \
+			   VIRTCHNL_VF_OFFLOAD_RX_FLEX_DESC)
 	struct virtchnl_vf_resource *vf_res; /* incl. all VSIs */
 	struct virtchnl_vsi_resource *vsi_res; /* our LAN VSI */
 	struct virtchnl_version_info pf_version;
@@ -656,6 +758,20 @@ extern char iavf_driver_name[];
 extern const char iavf_driver_version[];
 extern struct workqueue_struct *iavf_wq;
 
+/**
+ * iavf_num_tx_rings - number of Tx rings to configure
+ * @adapter: pointer to adapter
+ *
+ * The XDP Tx rings are placed in tx_rings right after the rings backing the
+ * netdev Tx queues, and use the queue pairs following the active ones.  The
+ * ndo_xdp_xmit rings come last.
+ **/
+static inline int iavf_num_tx_rings(struct iavf_adapter *adapter)
+{
+	return adapter->num_active_queues + adapter->num_xdp_queues +
+	       adapter->num_xdp_xmit_queues;
+}
+
 /**
  * iavf_is_adq_enabled - adq enabled or not
  * @adapter: pointer to adapter
@@ -743,6 +859,8 @@ static inline void iavf_force_wb(struct iavf_vsi *vsi,
 int iavf_up(struct iavf_adapter *adapter);
 void iavf_down(struct iavf_adapter *adapter);
 int iavf_process_config(struct iavf_adapter *adapter);
+int iavf_open(struct net_device *netdev);
+int iavf_close(struct net_device *netdev);
 void iavf_schedule_reset(struct iavf_adapter *adapter);
 void iavf_reset(struct iavf_adapter *adapter);
 void iavf_set_ethtool_ops(struct net_device *netdev);
@@ -789,6 +907,7 @@ void iavf_disable_channels(struct iavf_adapter *adapter);
 void iavf_add_cloud_filter(struct iavf_adapter *adapter);
 void iavf_del_cloud_filter(struct iavf_adapter *adapter);
 void iavf_setup_ch_info(struct iavf_adapter *adapter, u32 flags);
+void iavf_set_irq_affinity(struct iavf_adapter *adapter);
 int iavf_lan_add_device(struct iavf_adapter *adapter);
 int iavf_lan_del_device(struct iavf_adapter *adapter);
 void iavf_client_subtask(struct iavf_adapter *adapter);
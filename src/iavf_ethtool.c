@@ -81,6 +81,26 @@ struct iavf_priv_flags {
 
 static const struct iavf_priv_flags iavf_gstrings_priv_flags[] = {
 	IAVF_PRIV_FLAG("legacy-rx", IAVF_FLAG_LEGACY_RX, 0),
+#ifdef HAVE_PAGE_POOL
+	IAVF_PRIV_FLAG("rx-page-pool", IAVF_FLAG_RX_PAGE_POOL, 0),
+#endif /* HAVE_PAGE_POOL */
+	IAVF_PRIV_FLAG("rx-page-cache", IAVF_FLAG_RX_PAGE_CACHE, 0),
+	IAVF_PRIV_FLAG("rx-hdr-split", IAVF_FLAG_RX_HDR_SPLIT, 0),
+	IAVF_PRIV_FLAG("rx-desc-16byte", IAVF_FLAG_RX_DESC_16B, 0),
+#ifdef HAVE_DIM
+	IAVF_PRIV_FLAG("itr-dim-latency", IAVF_FLAG_DIM_LATENCY, 0),
+	IAVF_PRIV_FLAG("itr-dim-balanced", IAVF_FLAG_DIM_BALANCED, 0),
+	IAVF_PRIV_FLAG("itr-dim-throughput", IAVF_FLAG_DIM_THROUGHPUT, 0),
+#endif /* HAVE_DIM */
+#ifdef HAVE_NAPI_THREADED
+	IAVF_PRIV_FLAG("napi-threaded", IAVF_FLAG_NAPI_THREADED, 0),
+#endif /* HAVE_NAPI_THREADED */
+	IAVF_PRIV_FLAG("tx-head-wb", IAVF_FLAG_TX_HEAD_WB, 0),
+	IAVF_PRIV_FLAG("tx-doorbell-coalesce", IAVF_FLAG_TX_DB_COALESCE, 0),
+	IAVF_PRIV_FLAG("tx-tstamp-completion", IAVF_FLAG_TX_TSTAMP_COMPL, 0),
+#ifdef HAVE_NETDEV_SELECT_QUEUE
+	IAVF_PRIV_FLAG("tx-flow-affine", IAVF_FLAG_TX_FLOW_AFFINE, 0),
+#endif /* HAVE_NETDEV_SELECT_QUEUE */
 };
 
 #define IAVF_PRIV_FLAGS_STR_LEN ARRAY_SIZE(iavf_gstrings_priv_flags)
@@ -91,6 +111,13 @@ static const struct iavf_priv_flags iavf_gstrings_chnl_priv_flags[] = {
 };
 #define IAVF_CHNL_PRIV_FLAGS_STR_LEN ARRAY_SIZE(iavf_gstrings_chnl_priv_flags)
 
+static const struct iavf_priv_flags iavf_gstrings_irq_priv_flags[] = {
+	IAVF_PRIV_FLAG("irq-numa-local", IAVF_FLAG_IRQ_NUMA_LOCAL, 0),
+	IAVF_PRIV_FLAG("irq-skip-smt", IAVF_FLAG_IRQ_SKIP_SMT, 0),
+	IAVF_PRIV_FLAG("irq-housekeeping", IAVF_FLAG_IRQ_HOUSEKEEPING, 0),
+};
+#define IAVF_IRQ_PRIV_FLAGS_STR_LEN ARRAY_SIZE(iavf_gstrings_irq_priv_flags)
+
 #endif /* HAVE_SWIOTLB_SKIP_CPU_SYNC */
 
 /**
@@ -207,7 +234,8 @@ static int iavf_get_sset_count(struct net_device *netdev, int sset)
 			 IAVF_VECTOR_STATS_LEN) * netdev->real_num_tx_queues);
 #ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
 	else if (sset == ETH_SS_PRIV_FLAGS)
-		return IAVF_PRIV_FLAGS_STR_LEN + IAVF_PRIV_FLAGS_STR_LEN;
+		return IAVF_PRIV_FLAGS_STR_LEN + IAVF_CHNL_PRIV_FLAGS_STR_LEN +
+		       IAVF_IRQ_PRIV_FLAGS_STR_LEN;
 #endif
 	else
 		return -EINVAL;
@@ -275,6 +303,12 @@ static void iavf_get_priv_flag_strings(struct net_device *netdev, u8 *data)
 			 iavf_gstrings_chnl_priv_flags[i].flag_string);
 		data += ETH_GSTRING_LEN;
 	}
+
+	for (i = 0; i < IAVF_IRQ_PRIV_FLAGS_STR_LEN; i++) {
+		snprintf(data, ETH_GSTRING_LEN, "%s",
+			 iavf_gstrings_irq_priv_flags[i].flag_string);
+		data += ETH_GSTRING_LEN;
+	}
 }
 #endif
 
@@ -351,12 +385,21 @@ static u32 iavf_get_priv_flags(struct net_device *netdev)
 {
 	struct iavf_adapter *adapter = netdev_priv(netdev);
 	const struct iavf_priv_flags *priv_flags;
+	u32 flags = adapter->flags;
 	u32 i, ret_flags = 0;
 
+#ifdef HAVE_NAPI_THREADED
+	/* threaded NAPI can also be switched through sysfs */
+	if (netdev->threaded)
+		flags |= IAVF_FLAG_NAPI_THREADED;
+	else
+		flags &= ~IAVF_FLAG_NAPI_THREADED;
+
+#endif /* HAVE_NAPI_THREADED */
 	for (i = 0; i < IAVF_PRIV_FLAGS_STR_LEN; i++) {
 		priv_flags = &iavf_gstrings_priv_flags[i];
 
-		if (priv_flags->flag & adapter->flags)
+		if (priv_flags->flag & flags)
 			ret_flags |= BIT(i);
 	}
 
@@ -367,6 +410,14 @@ static u32 iavf_get_priv_flags(struct net_device *netdev)
 			ret_flags |= BIT(i + IAVF_PRIV_FLAGS_STR_LEN);
 	}
 
+	for (i = 0; i < IAVF_IRQ_PRIV_FLAGS_STR_LEN; i++) {
+		priv_flags = &iavf_gstrings_irq_priv_flags[i];
+
+		if (priv_flags->flag & adapter->irq_place_flags)
+			ret_flags |= BIT(i + IAVF_PRIV_FLAGS_STR_LEN +
+					 IAVF_CHNL_PRIV_FLAGS_STR_LEN);
+	}
+
 	return ret_flags;
 }
 
@@ -431,6 +482,7 @@ static int iavf_set_priv_flags(struct net_device *netdev, u32 flags)
 {
 	struct iavf_adapter *adapter = netdev_priv(netdev);
 	u32 changed_chnl_flags;
+	u32 changed_irq_flags;
 	u32 changed_flags;
 	int ret;
 
@@ -457,13 +509,71 @@ static int iavf_set_priv_flags(struct net_device *netdev, u32 flags)
 		return ret;
 	}
 
+	ret = iavf_determine_priv_flag_change(&iavf_gstrings_irq_priv_flags[0],
+					      IAVF_IRQ_PRIV_FLAGS_STR_LEN,
+					      IAVF_PRIV_FLAGS_STR_LEN +
+					      IAVF_CHNL_PRIV_FLAGS_STR_LEN,
+					      flags, &adapter->irq_place_flags,
+					      &changed_irq_flags);
+	if (ret) {
+		if (ret == -EAGAIN)
+			dev_warn(&adapter->pdev->dev,
+				 "Unable to update adapter->irq_place_flags as it was modified by another thread...\n");
+		return ret;
+	}
+
 	/* Process any additional changes needed as a result of flag changes.
 	 * The changed_flags value reflects the list of bits that were changed
 	 * in the code above.
 	 */
 
-	/* issue a reset to force legacy-rx change to take effect */
-	if (changed_flags & IAVF_FLAG_LEGACY_RX) {
+	/* the descriptor format can only be picked if the PF allows it */
+	if ((changed_flags & IAVF_FLAG_RX_DESC_16B) &&
+	    (adapter->flags & IAVF_FLAG_RX_DESC_16B) &&
+	    !RXDID_ALLOWED(adapter)) {
+		dev_info(&adapter->pdev->dev,
+			 "PF does not allow choosing the Rx descriptor format\n");
+		adapter->flags &= ~IAVF_FLAG_RX_DESC_16B;
+		changed_flags &= ~IAVF_FLAG_RX_DESC_16B;
+		ret = -EOPNOTSUPP;
+	}
+
+	/* only one DIM profile can drive the ITR at a time */
+	if (hweight32(adapter->flags & IAVF_FLAG_DIM_MASK) > 1) {
+		dev_info(&adapter->pdev->dev,
+			 "Only one itr-dim profile can be enabled at a time\n");
+		adapter->flags ^= changed_flags & IAVF_FLAG_DIM_MASK;
+		changed_flags &= ~IAVF_FLAG_DIM_MASK;
+		ret = -EINVAL;
+	}
+
+#ifdef HAVE_NAPI_THREADED
+	/* takes effect right away, each q_vector gets a NAPI kthread that
+	 * can be pinned like any other task
+	 */
+	if (changed_flags & IAVF_FLAG_NAPI_THREADED) {
+		bool threaded = !!(adapter->flags & IAVF_FLAG_NAPI_THREADED);
+		int err;
+
+		err = dev_set_threaded(netdev, threaded);
+		if (err) {
+			dev_info(&adapter->pdev->dev,
+				 "Failed to %s threaded NAPI, err %d\n",
+				 threaded ? "enable" : "disable", err);
+			adapter->flags ^= IAVF_FLAG_NAPI_THREADED;
+			ret = err;
+		}
+	}
+
+#endif /* HAVE_NAPI_THREADED */
+	/* issue a reset to force legacy-rx/rx-page-pool/rx-page-cache/
+	 * rx-hdr-split/rx-desc-16byte/tx-head-wb/tx-doorbell-coalesce change
+	 * to take effect
+	 */
+	if (changed_flags & (IAVF_FLAG_LEGACY_RX | IAVF_FLAG_RX_PAGE_POOL |
+			     IAVF_FLAG_RX_PAGE_CACHE | IAVF_FLAG_RX_HDR_SPLIT |
+			     IAVF_FLAG_RX_DESC_16B | IAVF_FLAG_TX_HEAD_WB |
+			     IAVF_FLAG_TX_DB_COALESCE)) {
 		if (netif_running(netdev))
 			iavf_schedule_reset(adapter);
 	}
@@ -472,7 +582,20 @@ static int iavf_set_priv_flags(struct net_device *netdev, u32 flags)
 	 */
 	iavf_setup_ch_info(adapter, changed_chnl_flags);
 
-	return 0;
+	/* IRQ placement is re-hinted in place while the IRQs are requested,
+	 * and applied again whenever they are requested after a reset; the
+	 * critical section keeps a reset from freeing the vectors meanwhile
+	 */
+	if (changed_irq_flags) {
+		while (test_and_set_bit(__IAVF_IN_CRITICAL_TASK,
+					&adapter->crit_section))
+			usleep_range(500, 1000);
+		if (adapter->state == __IAVF_RUNNING)
+			iavf_set_irq_affinity(adapter);
+		clear_bit(__IAVF_IN_CRITICAL_TASK, &adapter->crit_section);
+	}
+
+	return ret;
 }
 #endif /* HAVE_SWIOTLB_SKIP_CPU_SYNC */
 #ifndef HAVE_NDO_SET_FEATURES
@@ -621,7 +744,9 @@ static void iavf_get_drvinfo(struct net_device *netdev,
 	strlcpy(drvinfo->fw_version, "N/A", 4);
 	strlcpy(drvinfo->bus_info, pci_name(adapter->pdev), 32);
 #ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
-	drvinfo->n_priv_flags = IAVF_PRIV_FLAGS_STR_LEN;
+	drvinfo->n_priv_flags = IAVF_PRIV_FLAGS_STR_LEN +
+				IAVF_CHNL_PRIV_FLAGS_STR_LEN +
+				IAVF_IRQ_PRIV_FLAGS_STR_LEN;
 #endif
 }
 
@@ -706,6 +831,97 @@ static int iavf_set_ringparam(struct net_device *netdev,
 	return 0;
 }
 
+#ifdef ETHTOOL_GTUNABLE
+/**
+ * iavf_get_tunable - Get a tunable value
+ * @netdev: network interface device structure
+ * @tuna: tunable being read
+ * @data: buffer for the value
+ *
+ * Returns 0 on success, -EOPNOTSUPP for tunables we don't handle
+ **/
+static int iavf_get_tunable(struct net_device *netdev,
+			    const struct ethtool_tunable *tuna, void *data)
+{
+	struct iavf_adapter *adapter = netdev_priv(netdev);
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = adapter->rx_copybreak;
+		break;
+	case ETHTOOL_TX_COPYBREAK:
+		*(u32 *)data = adapter->tx_copybreak;
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+/**
+ * iavf_set_tunable - Set a tunable value
+ * @netdev: network interface device structure
+ * @tuna: tunable being set
+ * @data: new value
+ *
+ * The Rx copybreak takes effect on the rings right away, no reset needed.
+ * So does the Tx copybreak, unless the bounce buffers have to be allocated
+ * or freed, which is done through a reset.
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_set_tunable(struct net_device *netdev,
+			    const struct ethtool_tunable *tuna,
+			    const void *data)
+{
+	struct iavf_adapter *adapter = netdev_priv(netdev);
+	u32 copybreak;
+	int i;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		copybreak = *(u32 *)data;
+		if (copybreak > IAVF_MAX_RX_COPYBREAK) {
+			netdev_err(netdev, "Rx copybreak %u out of range [0-%u]\n",
+				   copybreak, IAVF_MAX_RX_COPYBREAK);
+			return -EINVAL;
+		}
+
+		adapter->rx_copybreak = copybreak;
+		for (i = 0; i < adapter->num_active_queues; i++)
+			WRITE_ONCE(adapter->rx_rings[i].rx_copybreak,
+				   copybreak);
+		break;
+	case ETHTOOL_TX_COPYBREAK:
+		copybreak = *(u32 *)data;
+		if (copybreak > IAVF_MAX_TX_COPYBREAK) {
+			netdev_err(netdev, "Tx copybreak %u out of range [0-%u]\n",
+				   copybreak, IAVF_MAX_TX_COPYBREAK);
+			return -EINVAL;
+		}
+
+		if (!adapter->tx_copybreak != !copybreak) {
+			adapter->tx_copybreak = copybreak;
+			if (netif_running(netdev))
+				iavf_schedule_reset(adapter);
+			break;
+		}
+
+		adapter->tx_copybreak = copybreak;
+		for (i = 0; i < adapter->num_active_queues; i++)
+			if (adapter->tx_rings[i].tx_bounce)
+				WRITE_ONCE(adapter->tx_rings[i].tx_copybreak,
+					   copybreak);
+		break;
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+#endif /* ETHTOOL_GTUNABLE */
 /**
  * __iavf_get_coalesce - get per-queue coalesce settings
  * @netdev: the netdev to check
@@ -745,6 +961,7 @@ static int __iavf_get_coalesce(struct net_device *netdev,
 
 	ec->rx_coalesce_usecs = rx_ring->itr_setting & ~IAVF_ITR_DYNAMIC;
 	ec->tx_coalesce_usecs = tx_ring->itr_setting & ~IAVF_ITR_DYNAMIC;
+	ec->tx_max_coalesced_frames_irq = tx_ring->work_limit;
 
 	return 0;
 }
@@ -852,10 +1069,16 @@ static int __iavf_set_coalesce(struct net_device *netdev,
 {
 	struct iavf_adapter *adapter = netdev_priv(netdev);
 	struct iavf_vsi *vsi = &adapter->vsi;
+	u32 work_limit;
 	int i;
 
-	if (ec->tx_max_coalesced_frames_irq || ec->rx_max_coalesced_frames_irq)
-		vsi->work_limit = ec->tx_max_coalesced_frames_irq;
+	/* tx-frames-irq is the Tx cleanup budget of a poll, 0 leaves it */
+	work_limit = ec->tx_max_coalesced_frames_irq;
+	if (work_limit > IAVF_MAX_TXD) {
+		netif_info(adapter, drv, netdev, "Invalid value, tx-frames-irq range is 0-%d, 0 keeps the current value\n",
+			   IAVF_MAX_TXD);
+		return -EINVAL;
+	}
 
 	if (ec->rx_coalesce_usecs == 0) {
 		if (ec->use_adaptive_rx_coalesce)
@@ -882,9 +1105,16 @@ static int __iavf_set_coalesce(struct net_device *netdev,
 		for (i = 0; i < adapter->num_active_queues; i++)
 			if (iavf_set_itr_per_queue(adapter, ec, i))
 				return -EINVAL;
+		if (work_limit) {
+			vsi->work_limit = work_limit;
+			for (i = 0; i < iavf_num_tx_rings(adapter); i++)
+				adapter->tx_rings[i].work_limit = work_limit;
+		}
 	} else if (queue < adapter->num_active_queues) {
 		if (iavf_set_itr_per_queue(adapter, ec, queue))
 			return -EINVAL;
+		if (work_limit)
+			adapter->tx_rings[queue].work_limit = work_limit;
 	} else {
 		netif_info(adapter, drv, netdev, "Invalid queue value, queue range is 0 - %d\n",
 			   adapter->num_active_queues - 1);
@@ -1011,6 +1241,14 @@ static int iavf_set_channels(struct net_device *netdev,
 	if (num_req == 0 || num_req > adapter->vsi_res->num_queue_pairs)
 		return -EINVAL;
 
+	/* with XDP each channel also consumes a queue pair for XDP_TX */
+	if (adapter->vsi.xdp_prog &&
+	    num_req * 2 > adapter->vsi_res->num_queue_pairs) {
+		dev_info(&adapter->pdev->dev, "Cannot use more than %d channels while an XDP program is attached\n",
+			 adapter->vsi_res->num_queue_pairs / 2);
+		return -EINVAL;
+	}
+
 	if (num_req == adapter->num_active_queues)
 		return 0;
 
@@ -1161,6 +1399,31 @@ static int iavf_set_rxfh(struct net_device *netdev, const u32 *indir,
 }
 #endif /* ETHTOOL_GRSSH && ETHTOOL_SRSSH */
 
+#ifdef HAVE_ETHTOOL_GET_TS_INFO
+/**
+ * iavf_get_ts_info - report the timestamping capabilities
+ * @netdev: network interface device structure
+ * @info: timestamping capabilities to fill in
+ *
+ * The VF has no PHC and no access to the PF's timestamp registers, so only
+ * software timestamping is advertised.  With the tx-tstamp-completion
+ * private flag set, the Tx software stamps are taken when the descriptor
+ * completes instead, see iavf_tx_tstamp().
+ **/
+static int iavf_get_ts_info(struct net_device *netdev,
+			    struct ethtool_ts_info *info)
+{
+	info->so_timestamping = SOF_TIMESTAMPING_TX_SOFTWARE |
+				SOF_TIMESTAMPING_RX_SOFTWARE |
+				SOF_TIMESTAMPING_SOFTWARE;
+	info->phc_index = -1;
+	info->tx_types = BIT(HWTSTAMP_TX_OFF);
+	info->rx_filters = BIT(HWTSTAMP_FILTER_NONE);
+
+	return 0;
+}
+
+#endif /* HAVE_ETHTOOL_GET_TS_INFO */
 static const struct ethtool_ops iavf_ethtool_ops = {
 #ifdef ETHTOOL_COALESCE_USECS
 	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
@@ -1170,8 +1433,15 @@ static const struct ethtool_ops iavf_ethtool_ops = {
 #endif /* ETHTOOL_COALESCE_USECS */
 	.get_drvinfo		= iavf_get_drvinfo,
 	.get_link		= ethtool_op_get_link,
+#ifdef HAVE_ETHTOOL_GET_TS_INFO
+	.get_ts_info		= iavf_get_ts_info,
+#endif /* HAVE_ETHTOOL_GET_TS_INFO */
 	.get_ringparam		= iavf_get_ringparam,
 	.set_ringparam		= iavf_set_ringparam,
+#ifdef ETHTOOL_GTUNABLE
+	.get_tunable		= iavf_get_tunable,
+	.set_tunable		= iavf_set_tunable,
+#endif /* ETHTOOL_GTUNABLE */
 #ifndef HAVE_NDO_SET_FEATURES
 	.get_rx_csum		= iavf_get_rx_csum,
 	.set_rx_csum		= iavf_set_rx_csum,
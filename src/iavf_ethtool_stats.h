@@ -63,6 +63,17 @@ static struct iavf_stats iavf_gstrings_queue_stats_poll[] = {
 };
 
 static struct iavf_stats iavf_gstrings_queue_stats_tx[] = {
+	IAVF_QUEUE_STAT("%s-%u.tx_head_wb_off", tx_stats.tx_head_wb_off),
+	IAVF_QUEUE_STAT("%s-%u.tx_bounce", tx_stats.tx_bounce),
+	IAVF_QUEUE_STAT("%s-%u.tx_coalesce", tx_stats.tx_coalesce),
+	IAVF_QUEUE_STAT("%s-%u.tx_linearize", tx_stats.tx_linearize),
+	IAVF_QUEUE_STAT("%s-%u.tx_work_boost", tx_stats.tx_work_boost),
+	IAVF_QUEUE_STAT("%s-%u.tx_work_exhausted", tx_stats.tx_work_exhausted),
+	IAVF_QUEUE_STAT("%s-%u.tx_doorbell", tx_stats.tx_doorbell),
+	IAVF_QUEUE_STAT("%s-%u.tx_db_deferred", tx_stats.tx_db_deferred),
+	IAVF_QUEUE_STAT("%s-%u.tx_db_napi", tx_stats.tx_db_napi),
+	IAVF_QUEUE_STAT("%s-%u.tx_db_timer", tx_stats.tx_db_timer),
+	IAVF_QUEUE_STAT("%s-%u.tx_tstamp", tx_stats.tx_tstamp),
 };
 
 static struct iavf_stats iavf_gstrings_queue_stats_rx[] = {
@@ -72,6 +83,13 @@ static struct iavf_stats iavf_gstrings_queue_stats_rx[] = {
 	IAVF_QUEUE_STAT("%s-%u.tcp_rst_recv", ch_q_stats.rx.tcp_rst_recv),
 	IAVF_QUEUE_STAT("%s-%u.tcp_syn_recv", ch_q_stats.rx.tcp_syn_recv),
 	IAVF_QUEUE_STAT("%s-%u.bp_no_data_pkt", ch_q_stats.rx.bp_no_data_pkt),
+	IAVF_QUEUE_STAT("%s-%u.nogro_list_batches",
+			rx_stats.nogro_list_batches),
+	IAVF_QUEUE_STAT("%s-%u.nogro_list_pkts", rx_stats.nogro_list_pkts),
+	IAVF_QUEUE_STAT("%s-%u.copybreak_pkts", rx_stats.copybreak_pkts),
+	IAVF_QUEUE_STAT("%s-%u.page_cache_hit", rx_stats.page_cache_hit),
+	IAVF_QUEUE_STAT("%s-%u.page_cache_miss", rx_stats.page_cache_miss),
+	IAVF_QUEUE_STAT("%s-%u.rx_starved", rx_stats.rx_starved),
 };
 
 static struct iavf_stats iavf_gstrings_queue_stats_vector[] = {
@@ -80,6 +98,7 @@ static struct iavf_stats iavf_gstrings_queue_stats_vector[] = {
 	IAVF_VECTOR_STAT("%s-%u.intr_to_bp", ch_stats.intr_to_bp),
 	IAVF_VECTOR_STAT("%s-%u.bp_to_bp", ch_stats.bp_to_bp),
 	IAVF_VECTOR_STAT("%s-%u.in_intr", ch_stats.in_intr),
+	IAVF_VECTOR_STAT("%s-%u.in_threaded", ch_stats.in_threaded),
 	IAVF_VECTOR_STAT("%s-%u.bp_to_intr", ch_stats.bp_to_intr),
 	IAVF_VECTOR_STAT("%s-%u.intr_to_intr", ch_stats.intr_to_intr),
 
@@ -125,6 +144,12 @@ static struct iavf_stats iavf_gstrings_queue_stats_vector[] = {
 	/* enable SW triggered interrupt due to not_clean_complete */
 	IAVF_VECTOR_STAT("%s-%u.sw_intr_not_cc",
 			 ch_stats.intr_en_not_clean_complete),
+
+	/* ITR register updates and DIM decisions, for either ITR engine */
+	IAVF_VECTOR_STAT("%s-%u.rx_itr_updates", itr_stats.rx_itr_updates),
+	IAVF_VECTOR_STAT("%s-%u.tx_itr_updates", itr_stats.tx_itr_updates),
+	IAVF_VECTOR_STAT("%s-%u.rx_dim_moves", itr_stats.rx_dim_moves),
+	IAVF_VECTOR_STAT("%s-%u.tx_dim_moves", itr_stats.tx_dim_moves),
 };
 
 /**
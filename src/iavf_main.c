@@ -14,7 +14,6 @@
 
 static int iavf_setup_all_tx_resources(struct iavf_adapter *adapter);
 static int iavf_setup_all_rx_resources(struct iavf_adapter *adapter);
-static int iavf_close(struct net_device *netdev);
 static void iavf_init_get_resources(struct iavf_adapter *adapter);
 static int iavf_check_reset_complete(struct iavf_hw *hw);
 static void iavf_handle_reset(struct iavf_adapter *adapter);
@@ -234,7 +233,9 @@ iavf_map_vector_to_rxq(struct iavf_adapter *adapter, int v_idx, int r_idx)
 	rx_ring->q_vector = q_vector;
 	rx_ring->next = q_vector->rx.ring;
 	rx_ring->vsi = &adapter->vsi;
+	rx_ring->rx_deficit = 0;
 	q_vector->rx.ring = rx_ring;
+	q_vector->rx_drr_next = NULL;
 	q_vector->rx.count++;
 	q_vector->rx.next_update = jiffies + 1;
 	q_vector->rx.target_itr = ITR_TO_REG(rx_ring->itr_setting);
@@ -270,6 +271,29 @@ iavf_map_vector_to_txq(struct iavf_adapter *adapter, int v_idx, int t_idx)
 	q_vector->tx.current_itr = q_vector->tx.target_itr;
 }
 
+/**
+ * iavf_map_vector_to_xdpq - associate irqs with XDP Tx queues
+ * @adapter: board private structure
+ * @v_idx: interrupt number
+ * @xdp_ring: XDP Tx ring to clean from the vector
+ *
+ * An XDP_TX ring is cleaned by the same vector as the Rx queue feeding it,
+ * so it never needs any locking.  The ndo_xdp_xmit rings are fed from any
+ * CPU and are simply spread over the vectors.
+ **/
+static void
+iavf_map_vector_to_xdpq(struct iavf_adapter *adapter, int v_idx,
+			struct iavf_ring *xdp_ring)
+{
+	struct iavf_q_vector *q_vector = &adapter->q_vectors[v_idx];
+
+	xdp_ring->q_vector = q_vector;
+	xdp_ring->next = q_vector->tx.ring;
+	xdp_ring->vsi = &adapter->vsi;
+	q_vector->tx.ring = xdp_ring;
+	q_vector->tx.count++;
+}
+
 /**
  * iavf_map_rings_to_vectors - Maps descriptor rings to vectors
  * @adapter: board private structure to initialize
@@ -291,6 +315,9 @@ static void iavf_map_rings_to_vectors(struct iavf_adapter *adapter)
 	for (; ridx < rings_remaining; ridx++) {
 		iavf_map_vector_to_rxq(adapter, vidx, ridx);
 		iavf_map_vector_to_txq(adapter, vidx, ridx);
+		if (ridx < adapter->num_xdp_queues)
+			iavf_map_vector_to_xdpq(adapter, vidx,
+						adapter->vsi.xdp_rings[ridx]);
 
 		/* In the case where we have more queues than vectors, continue
 		 * round-robin on vectors until all queues are mapped.
@@ -299,6 +326,10 @@ static void iavf_map_rings_to_vectors(struct iavf_adapter *adapter)
 			vidx = 0;
 	}
 
+	for (ridx = 0; ridx < adapter->num_xdp_xmit_queues; ridx++)
+		iavf_map_vector_to_xdpq(adapter, ridx % q_vectors,
+					adapter->vsi.xdp_xmit_rings[ridx]);
+
 	adapter->aq_required |= IAVF_FLAG_AQ_MAP_VECTORS;
 }
 
@@ -318,6 +349,11 @@ static void iavf_irq_affinity_notify(struct irq_affinity_notify *notify,
 		container_of(notify, struct iavf_q_vector, affinity_notify);
 
 	cpumask_copy(&q_vector->affinity_mask, mask);
+
+	/* nothing is moved here: Rx page refills use the new node from now
+	 * on, the buffer info arrays move with the next reinit
+	 */
+	WRITE_ONCE(q_vector->numa_node, cpu_to_node(cpumask_first(mask)));
 }
 
 /**
@@ -331,6 +367,125 @@ static void iavf_irq_affinity_notify(struct irq_affinity_notify *notify,
 static void iavf_irq_affinity_release(struct kref *ref) {}
 #endif /* HAVE_IRQ_AFFINITY_NOTIFY */
 
+/**
+ * iavf_irq_cpu_allowed - check a CPU against the housekeeping policy
+ * @cpu: online CPU
+ * @hk: honour the housekeeping CPUs
+ **/
+static bool iavf_irq_cpu_allowed(int cpu, bool hk)
+{
+#ifdef HAVE_HK_FLAG_MANAGED_IRQ
+	if (hk)
+		return cpumask_test_cpu(cpu,
+					housekeeping_cpumask(HK_FLAG_MANAGED_IRQ));
+#endif /* HAVE_HK_FLAG_MANAGED_IRQ */
+	return true;
+}
+
+/**
+ * iavf_irq_cpu_tier - rank a CPU for the IRQ placement policies
+ * @cpu: CPU to rank
+ * @policy: IAVF_FLAG_IRQ_* placement flags
+ * @node: NUMA node of the device
+ *
+ * CPUs on the node of the device come before the remote ones, and within
+ * those the first thread of each core comes before its SMT siblings.
+ * Returns 0 (best) to 3.
+ **/
+static int iavf_irq_cpu_tier(int cpu, u32 policy, int node)
+{
+	int tier = 0;
+
+	if ((policy & IAVF_FLAG_IRQ_NUMA_LOCAL) && node != NUMA_NO_NODE &&
+	    cpu_to_node(cpu) != node)
+		tier += 2;
+	if ((policy & IAVF_FLAG_IRQ_SKIP_SMT) &&
+	    cpumask_first(topology_sibling_cpumask(cpu)) != cpu)
+		tier++;
+
+	return tier;
+}
+
+/**
+ * iavf_irq_cpu - pick the CPU servicing a queue vector
+ * @adapter: board private structure
+ * @v_idx: index of the vector
+ *
+ * Without a placement policy the vectors are spread over the online CPUs
+ * as before.  Otherwise the allowed CPUs are ranked by iavf_irq_cpu_tier()
+ * and handed out in that order, wrapping around when there are more
+ * vectors than CPUs.  If the housekeeping policy leaves no CPU online it
+ * is ignored.
+ **/
+static int iavf_irq_cpu(struct iavf_adapter *adapter, int v_idx)
+{
+	u32 policy = READ_ONCE(adapter->irq_place_flags);
+	int node = dev_to_node(&adapter->pdev->dev);
+	bool hk = !!(policy & IAVF_FLAG_IRQ_HOUSEKEEPING);
+	int cpu, tier, n = 0;
+
+	if (!policy)
+		return cpumask_local_spread(v_idx, -1);
+
+	for_each_online_cpu(cpu)
+		if (iavf_irq_cpu_allowed(cpu, hk))
+			n++;
+	if (!n) {
+		hk = false;
+		n = num_online_cpus();
+	}
+
+	v_idx %= n;
+	for (tier = 0; tier < 4; tier++) {
+		for_each_online_cpu(cpu) {
+			if (!iavf_irq_cpu_allowed(cpu, hk) ||
+			    iavf_irq_cpu_tier(cpu, policy, node) != tier)
+				continue;
+			if (!v_idx--)
+				return cpu;
+		}
+	}
+
+	/* CPUs went offline under us */
+	return cpumask_local_spread(v_idx, -1);
+}
+
+#ifdef HAVE_IRQ_AFFINITY_HINT
+/**
+ * iavf_set_irq_affinity - apply the IRQ placement policies
+ * @adapter: board private structure
+ *
+ * Re-hints the IRQs of the queue vectors that are requested, so a change of
+ * the ethtool private flags takes effect without a reset.  The buffer info
+ * arrays follow to the new node with the next reinit.
+ **/
+void iavf_set_irq_affinity(struct iavf_adapter *adapter)
+{
+	int q_vectors = adapter->num_msix_vectors - NONQ_VECS;
+	int vector;
+
+	if (!adapter->msix_entries || !adapter->q_vectors)
+		return;
+
+	for (vector = 0; vector < q_vectors; vector++) {
+		struct iavf_q_vector *q_vector = &adapter->q_vectors[vector];
+		int irq_num = adapter->msix_entries[vector + NONQ_VECS].vector;
+		int cpu;
+
+		if (!q_vector->tx.ring && !q_vector->rx.ring)
+			continue;
+
+		cpu = iavf_irq_cpu(adapter, q_vector->v_idx);
+		WRITE_ONCE(q_vector->numa_node, cpu_to_node(cpu));
+		irq_set_affinity_hint(irq_num, get_cpu_mask(cpu));
+	}
+}
+#else
+void iavf_set_irq_affinity(struct iavf_adapter *adapter)
+{
+}
+#endif /* HAVE_IRQ_AFFINITY_HINT */
+
 /**
  * iavf_request_traffic_irqs - Initialize MSI-X interrupts
  * @adapter: board private structure
@@ -387,11 +542,13 @@ iavf_request_traffic_irqs(struct iavf_adapter *adapter, char *basename)
 		irq_set_affinity_notifier(irq_num, &q_vector->affinity_notify);
 #endif
 #ifdef HAVE_IRQ_AFFINITY_HINT
-		/* Spread the IRQ affinity hints across online CPUs. Note that
-		 * get_cpu_mask returns a mask with a permanent lifetime so
-		 * it's safe to use as a hint for irq_set_affinity_hint.
+		/* Spread the IRQ affinity hints across online CPUs, following
+		 * the placement policies if any. Note that get_cpu_mask returns
+		 * a mask with a permanent lifetime so it's safe to use as a
+		 * hint for irq_set_affinity_hint.
 		 */
-		cpu = cpumask_local_spread(q_vector->v_idx, -1);
+		cpu = iavf_irq_cpu(adapter, q_vector->v_idx);
+		q_vector->numa_node = cpu_to_node(cpu);
 		irq_set_affinity_hint(irq_num, get_cpu_mask(cpu));
 #endif /* HAVE_IRQ_AFFINITY_HINT */
 	}
@@ -495,8 +652,13 @@ static void iavf_configure_tx(struct iavf_adapter *adapter)
 	struct iavf_hw *hw = &adapter->hw;
 	int i;
 
-	for (i = 0; i < adapter->num_active_queues; i++)
+	for (i = 0; i < iavf_num_tx_rings(adapter); i++)
 		adapter->tx_rings[i].tail = hw->hw_addr + IAVF_QTX_TAIL1(i);
+
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	for (i = 0; i < adapter->num_xdp_queues; i++)
+		adapter->vsi.xdp_rings[i]->xsk_pool = iavf_xsk_pool(adapter, i);
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 }
 
 /**
@@ -535,11 +697,30 @@ static void iavf_configure_rx(struct iavf_adapter *adapter)
 	for (i = 0; i < adapter->num_active_queues; i++) {
 		adapter->rx_rings[i].tail = hw->hw_addr + IAVF_QRX_TAIL1(i);
 		adapter->rx_rings[i].rx_buf_len = rx_buf_len;
+		adapter->rx_rings[i].rx_copybreak = adapter->rx_copybreak;
 
 		if (adapter->flags & IAVF_FLAG_LEGACY_RX)
 			clear_ring_build_skb_enabled(&adapter->rx_rings[i]);
 		else
 			set_ring_build_skb_enabled(&adapter->rx_rings[i]);
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+
+		iavf_xsk_configure_rx_ring(&adapter->rx_rings[i]);
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+
+		/* header split changes the buffer offset, so it goes before
+		 * the page_pool that is created with that offset
+		 */
+		if (adapter->flags & IAVF_FLAG_RX_HDR_SPLIT)
+			iavf_setup_rx_hdr_split(&adapter->rx_rings[i]);
+#ifdef HAVE_PAGE_POOL
+
+		if (adapter->flags & IAVF_FLAG_RX_PAGE_POOL)
+			iavf_setup_rx_page_pool(&adapter->rx_rings[i]);
+#endif /* HAVE_PAGE_POOL */
+
+		if (adapter->flags & IAVF_FLAG_RX_PAGE_CACHE)
+			iavf_setup_rx_page_cache(&adapter->rx_rings[i]);
 	}
 }
 
@@ -975,6 +1156,12 @@ static void iavf_configure(struct iavf_adapter *adapter)
 	for (i = 0; i < adapter->num_active_queues; i++) {
 		struct iavf_ring *ring = &adapter->rx_rings[i];
 
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+		if (ring->xsk_pool) {
+			iavf_alloc_rx_buffers_zc(ring, IAVF_DESC_UNUSED(ring));
+			continue;
+		}
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 		iavf_alloc_rx_buffers(ring, IAVF_DESC_UNUSED(ring));
 	}
 }
@@ -1129,6 +1316,12 @@ static void iavf_free_queues(struct iavf_adapter *adapter)
 	if (!adapter->vsi_res)
 		return;
 	adapter->num_active_queues = 0;
+	adapter->num_xdp_queues = 0;
+	adapter->num_xdp_xmit_queues = 0;
+	kfree(adapter->vsi.xdp_rings);
+	adapter->vsi.xdp_rings = NULL;
+	kfree(adapter->vsi.xdp_xmit_rings);
+	adapter->vsi.xdp_xmit_rings = NULL;
 	kfree(adapter->tx_rings);
 	adapter->tx_rings = NULL;
 	kfree(adapter->rx_rings);
@@ -1145,7 +1338,8 @@ static void iavf_free_queues(struct iavf_adapter *adapter)
  **/
 static int iavf_alloc_queues(struct iavf_adapter *adapter)
 {
-	int i, num_active_queues;
+	int i, num_active_queues, num_xdp_queues = 0, num_xdp_xmit_queues = 0;
+	int num_tx_rings;
 
 	/* If we're in reset reallocating queues we don't actually know yet for
 	 * certain the PF gave us the number of queues we asked for but we'll
@@ -1165,11 +1359,40 @@ static int iavf_alloc_queues(struct iavf_adapter *adapter)
 					  adapter->vsi_res->num_queue_pairs,
 					  (int)(num_online_cpus()));
 
+	/* Every Rx queue running an XDP program gets a dedicated Tx queue for
+	 * XDP_TX, taken from the queue pairs above the ones used by the stack.
+	 */
+	if (adapter->vsi.xdp_prog) {
+		num_active_queues = min_t(int, num_active_queues,
+					  adapter->vsi_res->num_queue_pairs / 2);
+		num_xdp_queues = num_active_queues;
+		/* Whatever is left serves ndo_xdp_xmit, a ring per CPU if the
+		 * PF gave us enough of them.
+		 */
+		num_xdp_xmit_queues = min_t(int, num_online_cpus(),
+					    adapter->vsi_res->num_queue_pairs -
+					    2 * num_active_queues);
+	}
+	num_tx_rings = num_active_queues + num_xdp_queues + num_xdp_xmit_queues;
 
-	adapter->tx_rings = kcalloc(num_active_queues,
-				    sizeof(struct iavf_ring), GFP_KERNEL);
+	adapter->tx_rings = kcalloc(num_tx_rings, sizeof(struct iavf_ring),
+				    GFP_KERNEL);
 	if (!adapter->tx_rings)
 		goto err_out;
+	if (num_xdp_queues) {
+		adapter->vsi.xdp_rings = kcalloc(num_xdp_queues,
+						 sizeof(struct iavf_ring *),
+						 GFP_KERNEL);
+		if (!adapter->vsi.xdp_rings)
+			goto err_out;
+	}
+	if (num_xdp_xmit_queues) {
+		adapter->vsi.xdp_xmit_rings = kcalloc(num_xdp_xmit_queues,
+						      sizeof(struct iavf_ring *),
+						      GFP_KERNEL);
+		if (!adapter->vsi.xdp_xmit_rings)
+			goto err_out;
+	}
 	adapter->rx_rings = kcalloc(num_active_queues,
 				    sizeof(struct iavf_ring), GFP_KERNEL);
 	if (!adapter->rx_rings)
@@ -1186,19 +1409,64 @@ static int iavf_alloc_queues(struct iavf_adapter *adapter)
 		tx_ring->dev = pci_dev_to_dev(adapter->pdev);
 		tx_ring->count = adapter->tx_desc_count;
 		tx_ring->itr_setting = IAVF_ITR_TX_DEF;
+		tx_ring->work_limit = adapter->vsi.work_limit;
 
 		if (adapter->flags & IAVF_FLAG_WB_ON_ITR_CAPABLE)
 			tx_ring->flags |= IAVF_TXR_FLAGS_WB_ON_ITR;
 
 		rx_ring = &adapter->rx_rings[i];
 		rx_ring->queue_index = i;
+		rx_ring->vsi = &adapter->vsi;
 		rx_ring->netdev = adapter->netdev;
 		rx_ring->dev = pci_dev_to_dev(adapter->pdev);
 		rx_ring->count = adapter->rx_desc_count;
 		rx_ring->itr_setting = IAVF_ITR_RX_DEF;
 	}
 
+	for (i = 0; i < num_xdp_queues; i++) {
+		struct iavf_ring *xdp_ring;
+
+		xdp_ring = &adapter->tx_rings[num_active_queues + i];
+		xdp_ring->queue_index = num_active_queues + i;
+		xdp_ring->netdev = adapter->netdev;
+		xdp_ring->dev = pci_dev_to_dev(adapter->pdev);
+		xdp_ring->count = adapter->tx_desc_count;
+		xdp_ring->itr_setting = IAVF_ITR_TX_DEF;
+		xdp_ring->work_limit = adapter->vsi.work_limit;
+
+		if (adapter->flags & IAVF_FLAG_WB_ON_ITR_CAPABLE)
+			xdp_ring->flags |= IAVF_TXR_FLAGS_WB_ON_ITR;
+		set_ring_xdp(xdp_ring);
+
+		adapter->vsi.xdp_rings[i] = xdp_ring;
+	}
+
+	for (i = 0; i < num_xdp_xmit_queues; i++) {
+		struct iavf_ring *xdp_ring;
+		int q_idx = num_active_queues + num_xdp_queues + i;
+
+		xdp_ring = &adapter->tx_rings[q_idx];
+		xdp_ring->queue_index = q_idx;
+		xdp_ring->netdev = adapter->netdev;
+		xdp_ring->dev = pci_dev_to_dev(adapter->pdev);
+		xdp_ring->count = adapter->tx_desc_count;
+		xdp_ring->itr_setting = IAVF_ITR_TX_DEF;
+		xdp_ring->work_limit = adapter->vsi.work_limit;
+
+		if (adapter->flags & IAVF_FLAG_WB_ON_ITR_CAPABLE)
+			xdp_ring->flags |= IAVF_TXR_FLAGS_WB_ON_ITR;
+		set_ring_xdp(xdp_ring);
+		/* CPUs without a ring of their own share one */
+		if (num_xdp_xmit_queues < nr_cpu_ids)
+			xdp_ring->flags |= IAVF_TXR_FLAGS_XDP_SHARED;
+		spin_lock_init(&xdp_ring->tx_lock);
+
+		adapter->vsi.xdp_xmit_rings[i] = xdp_ring;
+	}
+
 	adapter->num_active_queues = num_active_queues;
+	adapter->num_xdp_queues = num_xdp_queues;
+	adapter->num_xdp_xmit_queues = num_xdp_xmit_queues;
 
 	return 0;
 
@@ -1279,9 +1547,21 @@ static int iavf_alloc_q_vectors(struct iavf_adapter *adapter)
 		q_vector->vsi = &adapter->vsi;
 		q_vector->v_idx = q_idx;
 		q_vector->reg_idx = q_idx;
+		/* the IRQ is hinted to this CPU once it is requested, so the
+		 * rings set up before that already land on its node
+		 */
+		q_vector->numa_node = cpu_to_node(iavf_irq_cpu(adapter, q_idx));
 #ifdef HAVE_IRQ_AFFINITY_NOTIFY
 		cpumask_copy(&q_vector->affinity_mask, cpu_possible_mask);
 #endif
+#ifdef HAVE_DIM
+		INIT_WORK(&q_vector->rx.dim.work, iavf_dim_work);
+		q_vector->rx.dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+		q_vector->rx.dim.priv = q_vector;
+		INIT_WORK(&q_vector->tx.dim.work, iavf_dim_work);
+		q_vector->tx.dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+		q_vector->tx.dim.priv = q_vector;
+#endif /* HAVE_DIM */
 		netif_napi_add(adapter->netdev, &q_vector->napi,
 			       iavf_napi_poll, NAPI_POLL_WEIGHT);
 	}
@@ -1310,6 +1590,10 @@ static void iavf_free_q_vectors(struct iavf_adapter *adapter)
 
 	for (q_idx = 0; q_idx < num_q_vectors; q_idx++) {
 		struct iavf_q_vector *q_vector = &adapter->q_vectors[q_idx];
+#ifdef HAVE_DIM
+		cancel_work_sync(&q_vector->rx.dim.work);
+		cancel_work_sync(&q_vector->tx.dim.work);
+#endif /* HAVE_DIM */
 		if (q_idx < napi_vectors)
 			netif_napi_del(&q_vector->napi);
 	}
@@ -1748,6 +2032,8 @@ static void iavf_init_get_resources(struct iavf_adapter *adapter)
 
 	adapter->tx_desc_count = IAVF_DEFAULT_TXD;
 	adapter->rx_desc_count = IAVF_DEFAULT_RXD;
+	adapter->rx_copybreak = IAVF_DEFAULT_RX_COPYBREAK;
+	adapter->tx_copybreak = IAVF_DEFAULT_TX_COPYBREAK;
 	ret = iavf_init_interrupt_scheme(adapter);
 	if (ret)
 		goto err_sw_init;
@@ -2561,7 +2847,7 @@ void iavf_free_all_tx_resources(struct iavf_adapter *adapter)
 	if (!adapter->tx_rings)
 		return;
 
-	for (i = 0; i < adapter->num_active_queues; i++)
+	for (i = 0; i < iavf_num_tx_rings(adapter); i++)
 		if (adapter->tx_rings[i].desc)
 			iavf_free_tx_resources(&adapter->tx_rings[i]);
 }
@@ -2580,8 +2866,18 @@ static int iavf_setup_all_tx_resources(struct iavf_adapter *adapter)
 {
 	int i, err = 0;
 
-	for (i = 0; i < adapter->num_active_queues; i++) {
+	for (i = 0; i < iavf_num_tx_rings(adapter); i++) {
 		adapter->tx_rings[i].count = adapter->tx_desc_count;
+		adapter->tx_rings[i].tx_copybreak = adapter->tx_copybreak;
+		adapter->tx_rings[i].flags &= ~(IAVF_TXR_FLAGS_HEAD_WB |
+						IAVF_TXR_FLAGS_HEAD_WB_SEEN |
+						IAVF_TXR_FLAGS_DB_DEFER);
+		if (adapter->flags & IAVF_FLAG_TX_HEAD_WB)
+			adapter->tx_rings[i].flags |= IAVF_TXR_FLAGS_HEAD_WB;
+		/* XDP rings write their tail per batch already */
+		if ((adapter->flags & IAVF_FLAG_TX_DB_COALESCE) &&
+		    !ring_is_xdp(&adapter->tx_rings[i]))
+			adapter->tx_rings[i].flags |= IAVF_TXR_FLAGS_DB_DEFER;
 		err = iavf_setup_tx_descriptors(&adapter->tx_rings[i]);
 		if (!err)
 			continue;
@@ -2609,6 +2905,11 @@ static int iavf_setup_all_rx_resources(struct iavf_adapter *adapter)
 
 	for (i = 0; i < adapter->num_active_queues; i++) {
 		adapter->rx_rings[i].count = adapter->rx_desc_count;
+		if ((adapter->flags & IAVF_FLAG_RX_DESC_16B) &&
+		    RXDID_ALLOWED(adapter))
+			adapter->rx_rings[i].flags |= IAVF_RXR_FLAGS_DESC_16B;
+		else
+			adapter->rx_rings[i].flags &= ~IAVF_RXR_FLAGS_DESC_16B;
 		err = iavf_setup_rx_descriptors(&adapter->rx_rings[i]);
 		if (!err)
 			continue;
@@ -2857,6 +3158,13 @@ static int __iavf_setup_tc(struct net_device *netdev, void *type_data)
 	num_tc = mqprio_qopt->qopt.num_tc;
 	mode = mqprio_qopt->mode;
 
+#ifdef HAVE_XDP_SUPPORT
+	if (mqprio_qopt->qopt.hw && adapter->vsi.xdp_prog) {
+		dev_info(&adapter->pdev->dev, "Cannot enable ADQ while an XDP program is attached\n");
+		return -EOPNOTSUPP;
+	}
+
+#endif /* HAVE_XDP_SUPPORT */
 	/* delete queue_channel */
 	if (!mqprio_qopt->qopt.hw) {
 		if (adapter->ch_config.state == __IAVF_TC_RUNNING) {
@@ -3607,7 +3915,7 @@ static int iavf_setup_tc(struct net_device *dev, enum tc_setup_type type,
  * handler is registered with the OS, the watchdog is started,
  * and the stack is notified that the interface is ready.
  **/
-static int iavf_open(struct net_device *netdev)
+int iavf_open(struct net_device *netdev)
 {
 	struct iavf_adapter *adapter = netdev_priv(netdev);
 	int err;
@@ -3685,7 +3993,7 @@ err_unlock:
  * needs to be disabled. All IRQs except vector 0 (reserved for admin queue)
  * are freed, along with all transmit and receive resources.
  **/
-static int iavf_close(struct net_device *netdev)
+int iavf_close(struct net_device *netdev)
 {
 	struct iavf_adapter *adapter = netdev_priv(netdev);
 	int status;
@@ -3750,6 +4058,171 @@ static struct net_device_stats *iavf_get_stats(struct net_device *netdev)
 	return &adapter->net_stats;
 }
 
+#ifdef HAVE_XDP_SUPPORT
+/**
+ * iavf_max_xdp_frame_size - returns the maximum allowed frame size for XDP
+ * @adapter: board private structure
+ *
+ * XDP programs only see the first buffer of a frame, so the whole frame has
+ * to fit into a single Rx buffer.
+ **/
+static int iavf_max_xdp_frame_size(struct iavf_adapter *adapter)
+{
+#if (PAGE_SIZE < 8192)
+	if (!(adapter->flags & IAVF_FLAG_LEGACY_RX))
+		return IAVF_RXBUFFER_3072;
+#endif
+	return IAVF_RXBUFFER_2048;
+}
+
+/**
+ * iavf_xdp_request_queues - ask the PF for queue pairs to run XDP on
+ * @adapter: board private structure
+ *
+ * XDP takes a queue pair per channel for XDP_TX, and ideally one per CPU for
+ * ndo_xdp_xmit.  If the PF didn't give us that many, ask for more.  A PF
+ * granting them resets the VF, one that can't answers and we make do with the
+ * pairs we have, see iavf_virtchnl_completion().
+ *
+ * Returns true if the request went out and the reset is up to the PF.
+ **/
+static bool iavf_xdp_request_queues(struct iavf_adapter *adapter)
+{
+	int needed = adapter->num_active_queues * 2 + num_online_cpus();
+
+	if (!(adapter->vf_res->vf_cap_flags & VIRTCHNL_VF_OFFLOAD_REQ_QUEUES))
+		return false;
+
+	if (needed <= adapter->vsi_res->num_queue_pairs ||
+	    adapter->vsi_res->num_queue_pairs >= IAVF_MAX_REQ_QUEUES)
+		return false;
+
+	adapter->flags |= IAVF_FLAG_XDP_REQ_QUEUES;
+	if (iavf_request_queues(adapter,
+				min_t(int, needed, IAVF_MAX_REQ_QUEUES))) {
+		adapter->flags &= ~IAVF_FLAG_XDP_REQ_QUEUES;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * iavf_xdp_setup - add/remove an XDP program
+ * @adapter: board private structure
+ * @prog: XDP program, NULL to remove the current one
+ *
+ * Adding the first program or removing the last one changes the number of
+ * Tx rings, which is done through a reset.  Replacing a program is done in
+ * place.
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xdp_setup(struct iavf_adapter *adapter, struct bpf_prog *prog)
+{
+	int frame_size = adapter->netdev->mtu + IAVF_PACKET_HDR_PAD;
+	struct bpf_prog *old_prog;
+	bool need_reset;
+	int i;
+
+	if (prog && frame_size > iavf_max_xdp_frame_size(adapter)) {
+		dev_info(&adapter->pdev->dev, "MTU too large to enable XDP\n");
+		return -EINVAL;
+	}
+
+#ifdef __TC_MQPRIO_MODE_MAX
+	if (prog && iavf_is_adq_enabled(adapter)) {
+		dev_info(&adapter->pdev->dev, "Cannot attach an XDP program while ADQ is enabled\n");
+		return -EOPNOTSUPP;
+	}
+
+#endif /* __TC_MQPRIO_MODE_MAX */
+	/* each channel needs a second Tx queue for XDP_TX */
+	if (prog && !adapter->vsi.xdp_prog &&
+	    adapter->num_active_queues * 2 >
+	    adapter->vsi_res->num_queue_pairs) {
+		dev_info(&adapter->pdev->dev, "XDP needs one extra Tx queue per channel, but only %d queue pairs are available for %d channels\n",
+			 adapter->vsi_res->num_queue_pairs,
+			 adapter->num_active_queues);
+		return -ENOSPC;
+	}
+
+	need_reset = (!!adapter->vsi.xdp_prog != !!prog);
+	old_prog = xchg(&adapter->vsi.xdp_prog, prog);
+
+	/* the netdev core drops the program when unregistering the netdev,
+	 * don't bring the rings back up for a device that is going away
+	 */
+	if (need_reset &&
+	    !test_bit(__IAVF_IN_REMOVE_TASK, &adapter->crit_section)) {
+		/* keep the current channel count across the reset */
+		adapter->num_req_queues = adapter->num_active_queues;
+		adapter->flags |= IAVF_FLAG_REINIT_ITR_NEEDED;
+		if (!prog || !iavf_xdp_request_queues(adapter))
+			iavf_schedule_reset(adapter);
+	}
+
+	/* When attaching the first program the rings pick it up once the XDP
+	 * Tx rings exist, i.e. when they are set up again after the reset.
+	 */
+	if (!need_reset || !prog)
+		for (i = 0; i < adapter->num_active_queues; i++)
+			WRITE_ONCE(adapter->rx_rings[i].xdp_prog,
+				   adapter->vsi.xdp_prog);
+
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+/**
+ * iavf_xdp - implements ndo_bpf for iavf
+ * @dev: netdevice
+ * @xdp: XDP command
+ **/
+#ifdef HAVE_NDO_BPF
+static int iavf_xdp(struct net_device *dev, struct netdev_bpf *xdp)
+#else
+static int iavf_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+#endif
+{
+	struct iavf_adapter *adapter = netdev_priv(dev);
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return iavf_xdp_setup(adapter, xdp->prog);
+#ifdef HAVE_XDP_QUERY_PROG
+	case XDP_QUERY_PROG:
+#ifndef NO_NETDEV_BPF_PROG_ATTACHED
+		xdp->prog_attached = !!adapter->vsi.xdp_prog;
+#endif /* !NO_NETDEV_BPF_PROG_ATTACHED */
+		xdp->prog_id = adapter->vsi.xdp_prog ?
+			       adapter->vsi.xdp_prog->aux->id : 0;
+		return 0;
+#endif /* HAVE_XDP_QUERY_PROG */
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+	case XDP_SETUP_XSK_POOL:
+		return iavf_xsk_pool_setup(adapter, xdp->xsk.pool,
+					   xdp->xsk.queue_id);
+#else
+#ifndef NO_XDP_QUERY_XSK_UMEM
+	case XDP_QUERY_XSK_UMEM:
+		return iavf_xsk_umem_query(adapter, &xdp->xsk.umem,
+					   xdp->xsk.queue_id);
+#endif /* NO_XDP_QUERY_XSK_UMEM */
+	case XDP_SETUP_XSK_UMEM:
+		return iavf_xsk_umem_setup(adapter, xdp->xsk.umem,
+					   xdp->xsk.queue_id);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+	default:
+		return -EINVAL;
+	}
+}
+
+#endif /* HAVE_XDP_SUPPORT */
 /**
  * iavf_change_mtu - Change the Maximum Transfer Unit
  * @netdev: network interface device structure
@@ -3765,6 +4238,14 @@ static int iavf_change_mtu(struct net_device *netdev, int new_mtu)
 	if ((new_mtu < 68) || (max_frame > IAVF_MAX_RXBUFFER))
 		return -EINVAL;
 
+#ifdef HAVE_XDP_SUPPORT
+	if (adapter->vsi.xdp_prog &&
+	    max_frame > iavf_max_xdp_frame_size(adapter)) {
+		netdev_err(netdev, "MTU %d is too large for XDP\n", new_mtu);
+		return -EINVAL;
+	}
+#endif /* HAVE_XDP_SUPPORT */
+
 #ifndef HAVE_NDO_FEATURES_CHECK
 	/* MTU < 576 causes problems with TSO */
 	if (new_mtu < 576) {
@@ -3794,6 +4275,61 @@ static int iavf_change_mtu(struct net_device *netdev, int new_mtu)
 	return 0;
 }
 
+/**
+ * iavf_set_ts_config - handle SIOCSHWTSTAMP
+ * @ifr: interface request holding the hwtstamp_config
+ *
+ * The PF gives the VF no way to stamp frames in hardware, so only the
+ * all-off configuration is accepted.  Completion time stamps are software
+ * stamps, turned on with the tx-tstamp-completion private flag.
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_set_ts_config(struct ifreq *ifr)
+{
+	struct hwtstamp_config config;
+
+	if (copy_from_user(&config, ifr->ifr_data, sizeof(config)))
+		return -EFAULT;
+
+	/* reserved for future extensions */
+	if (config.flags)
+		return -EINVAL;
+
+	if (config.tx_type != HWTSTAMP_TX_OFF ||
+	    config.rx_filter != HWTSTAMP_FILTER_NONE)
+		return -ERANGE;
+
+	return copy_to_user(ifr->ifr_data, &config, sizeof(config)) ?
+	       -EFAULT : 0;
+}
+
+/**
+ * iavf_ioctl - handle device specific ioctls
+ * @netdev: network interface device structure
+ * @ifr: interface request
+ * @cmd: ioctl command
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_ioctl(struct net_device __always_unused *netdev,
+		      struct ifreq *ifr, int cmd)
+{
+	struct hwtstamp_config config = { 0 };
+
+	switch (cmd) {
+#ifdef SIOCGHWTSTAMP
+	case SIOCGHWTSTAMP:
+		return copy_to_user(ifr->ifr_data, &config, sizeof(config)) ?
+		       -EFAULT : 0;
+#endif /* SIOCGHWTSTAMP */
+	case SIOCSHWTSTAMP:
+		return iavf_set_ts_config(ifr);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 /**
  * iavf_set_features - set the netdev feature flags
  * @netdev: ptr to the netdev being adjusted
@@ -3836,6 +4372,128 @@ static int iavf_set_features(struct net_device *netdev,
 	return 0;
 }
 
+#ifdef HAVE_NETDEV_SELECT_QUEUE
+/**
+ * iavf_flow_rx_queue - Find the Rx queue a flow is received on
+ * @skb: packet being sent
+ *
+ * Returns the Rx queue recorded in the packet or in its socket, or -1
+ **/
+static int iavf_flow_rx_queue(struct sk_buff *skb)
+{
+	if (skb_rx_queue_recorded(skb))
+		return skb_get_rx_queue(skb);
+#ifdef HAVE_SK_RX_QUEUE_GET
+	if (skb->sk && sk_fullsock(skb->sk))
+		return sk_rx_queue_get(skb->sk);
+#endif /* HAVE_SK_RX_QUEUE_GET */
+
+	return -1;
+}
+
+/**
+ * iavf_flow_affine_queue - Pick a Tx queue local to a flow
+ * @adapter: board private structure
+ * @skb: packet being sent
+ *
+ * A flow goes out on the queue paired with the Rx queue it comes in on,
+ * and a flow with no Rx queue on the queue of the sending CPU.  Like
+ * netdev_pick_tx(), the latter is remembered in the socket and only
+ * changes when the stack marks a packet ooo_okay, so a flow sent from
+ * several CPUs isn't reordered.  With ADQ the pick stays among the queues
+ * of the channel the packet's priority maps to.
+ *
+ * Returns the queue index, or -1 to leave the pick to the stack
+ **/
+static int iavf_flow_affine_queue(struct iavf_adapter *adapter,
+				  struct sk_buff *skb)
+{
+	struct net_device *netdev = adapter->netdev;
+	u16 base = 0, count = netdev->real_num_tx_queues;
+	int rxq = iavf_flow_rx_queue(skb);
+	struct sock *sk = skb->sk;
+	int qidx;
+
+	if (iavf_is_adq_enabled(adapter)) {
+		struct iavf_channel_ex *ch;
+		u8 tc;
+
+		tc = netdev_get_prio_tc_map(netdev, skb->priority);
+		if (tc >= adapter->num_tc)
+			return -1;
+
+		ch = &adapter->ch_config.ch_ex_info[tc];
+		base = ch->base_q;
+		count = ch->num_rxq;
+	}
+
+	if (!count)
+		return -1;
+
+	if (rxq >= base && rxq < base + count)
+		return rxq;
+
+	qidx = sk_tx_queue_get(sk);
+	if (qidx >= base && qidx < base + count && !skb->ooo_okay)
+		return qidx;
+
+	qidx = base + raw_smp_processor_id() % count;
+#ifdef HAVE_SK_FULLSOCK
+	if (sk && sk_fullsock(sk) && rcu_access_pointer(sk->sk_dst_cache))
+		sk_tx_queue_set(sk, qidx);
+#endif /* HAVE_SK_FULLSOCK */
+
+	return qidx;
+}
+
+/**
+ * iavf_select_queue - Select the Tx queue of a packet
+ * @netdev: network interface device structure
+ * @skb: packet being sent
+ *
+ * The flow-affine pick is made here, at every transmit, so it follows the
+ * queue layout across resets and channel changes, unlike XPS maps set up
+ * from user space.
+ **/
+#if defined(HAVE_NDO_SELECT_QUEUE_FALLBACK_REMOVED)
+static u16 iavf_select_queue(struct net_device *netdev, struct sk_buff *skb,
+			     struct net_device *sb_dev)
+#elif defined(HAVE_NDO_SELECT_QUEUE_SB_DEV)
+static u16 iavf_select_queue(struct net_device *netdev, struct sk_buff *skb,
+			     struct net_device *sb_dev,
+			     select_queue_fallback_t fallback)
+#elif defined(HAVE_NDO_SELECT_QUEUE_ACCEL_FALLBACK)
+static u16 iavf_select_queue(struct net_device *netdev, struct sk_buff *skb,
+			     void __always_unused *accel_priv,
+			     select_queue_fallback_t fallback)
+#elif defined(HAVE_NDO_SELECT_QUEUE_ACCEL)
+static u16 iavf_select_queue(struct net_device *netdev, struct sk_buff *skb,
+			     void __always_unused *accel_priv)
+#else
+static u16 iavf_select_queue(struct net_device *netdev, struct sk_buff *skb)
+#endif
+{
+	struct iavf_adapter *adapter = netdev_priv(netdev);
+	int qidx;
+
+	if (adapter->flags & IAVF_FLAG_TX_FLOW_AFFINE) {
+		qidx = iavf_flow_affine_queue(adapter, skb);
+		if (qidx >= 0)
+			return qidx;
+	}
+
+#if defined(HAVE_NDO_SELECT_QUEUE_FALLBACK_REMOVED)
+	return netdev_pick_tx(netdev, skb, sb_dev);
+#elif defined(HAVE_NDO_SELECT_QUEUE_SB_DEV)
+	return fallback(netdev, skb, sb_dev);
+#elif defined(HAVE_NDO_SELECT_QUEUE_ACCEL_FALLBACK)
+	return fallback(netdev, skb);
+#else
+	return skb_tx_hash(netdev, skb);
+#endif
+}
+
+#endif /* HAVE_NETDEV_SELECT_QUEUE */
 #ifdef HAVE_NDO_FEATURES_CHECK
 /**
  * iavf_features_check - Validate encapsulated packet conforms to limits
@@ -3941,6 +4599,9 @@ static const struct net_device_ops iavf_netdev_ops = {
 	.ndo_open		= iavf_open,
 	.ndo_stop		= iavf_close,
 	.ndo_start_xmit		= iavf_lan_xmit_frame,
+#ifdef HAVE_NETDEV_SELECT_QUEUE
+	.ndo_select_queue	= iavf_select_queue,
+#endif /* HAVE_NETDEV_SELECT_QUEUE */
 	.ndo_get_stats		= iavf_get_stats,
 	.ndo_set_rx_mode	= iavf_set_rx_mode,
 	.ndo_validate_addr	= eth_validate_addr,
@@ -3951,6 +4612,11 @@ static const struct net_device_ops iavf_netdev_ops = {
 	.ndo_change_mtu		= iavf_change_mtu,
 #endif /* HAVE_RHEL7_EXTENDED_MIN_MAX_MTU */
 	.ndo_tx_timeout		= iavf_tx_timeout,
+#ifdef HAVE_NDO_ETH_IOCTL
+	.ndo_eth_ioctl		= iavf_ioctl,
+#else
+	.ndo_do_ioctl		= iavf_ioctl,
+#endif /* HAVE_NDO_ETH_IOCTL */
 #ifdef HAVE_VLAN_RX_REGISTER
 	.ndo_vlan_rx_register	= iavf_vlan_rx_register,
 #endif
@@ -3970,6 +4636,23 @@ static const struct net_device_ops iavf_netdev_ops = {
 #ifdef HAVE_NDO_FEATURES_CHECK
 	.ndo_features_check     = iavf_features_check,
 #endif /* HAVE_NDO_FEATURES_CHECK */
+#ifdef HAVE_XDP_SUPPORT
+#ifdef HAVE_NDO_BPF
+	.ndo_bpf		= iavf_xdp,
+#else
+	.ndo_xdp		= iavf_xdp,
+#endif /* HAVE_NDO_BPF */
+#ifdef HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS
+	.ndo_xdp_xmit		= iavf_xdp_xmit,
+#endif /* HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS */
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+#ifdef HAVE_NDO_XSK_WAKEUP
+	.ndo_xsk_wakeup		= iavf_xsk_wakeup,
+#else
+	.ndo_xsk_async_xmit	= iavf_xsk_async_xmit,
+#endif /* HAVE_NDO_XSK_WAKEUP */
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+#endif /* HAVE_XDP_SUPPORT */
 #ifdef HAVE_RHEL6_NET_DEVICE_OPS_EXT
 };
 
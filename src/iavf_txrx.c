@@ -6,18 +6,6 @@
 #include "iavf_trace.h"
 #include "iavf_prototype.h"
 
-static inline __le64 build_ctob(u32 td_cmd, u32 td_offset, unsigned int size,
-				u32 td_tag)
-{
-	return cpu_to_le64(IAVF_TX_DESC_DTYPE_DATA |
-			   ((u64)td_cmd  << IAVF_TXD_QW1_CMD_SHIFT) |
-			   ((u64)td_offset << IAVF_TXD_QW1_OFFSET_SHIFT) |
-			   ((u64)size  << IAVF_TXD_QW1_TX_BUF_SZ_SHIFT) |
-			   ((u64)td_tag  << IAVF_TXD_QW1_L2TAG1_SHIFT));
-}
-
-#define IAVF_TXD_CMD (IAVF_TX_DESC_CMD_EOP | IAVF_TX_DESC_CMD_RS)
-
 /**
  * iavf_unmap_and_free_tx_resource - Release a Tx buffer
  * @ring:      the ring that owns the buffer
@@ -29,6 +17,14 @@ static void iavf_unmap_and_free_tx_resource(struct iavf_ring *ring,
 	if (tx_buffer->skb) {
 		if (tx_buffer->tx_flags & IAVF_TX_FLAGS_FD_SB)
 			kfree(tx_buffer->raw_buf);
+#ifdef HAVE_XDP_SUPPORT
+		else if (ring_is_xdp(ring))
+#ifdef HAVE_XDP_FRAME_STRUCT
+			xdp_return_frame(tx_buffer->xdpf);
+#else
+			page_frag_free(tx_buffer->raw_buf);
+#endif
+#endif /* HAVE_XDP_SUPPORT */
 		else
 			dev_kfree_skb_any(tx_buffer->skb);
 		if (dma_unmap_len(tx_buffer, len))
@@ -62,10 +58,21 @@ void iavf_clean_tx_ring(struct iavf_ring *tx_ring)
 	if (!tx_ring->tx_bi)
 		return;
 
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	if (ring_is_xdp(tx_ring) && tx_ring->xsk_pool) {
+		iavf_xsk_clean_tx_ring(tx_ring);
+		goto skip_free;
+	}
+
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 	/* Free all the Tx ring sk_buffs */
 	for (i = 0; i < tx_ring->count; i++)
 		iavf_unmap_and_free_tx_resource(tx_ring, &tx_ring->tx_bi[i]);
 
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+skip_free:
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+
 	bi_size = sizeof(struct iavf_tx_buffer) * tx_ring->count;
 	memset(tx_ring->tx_bi, 0, bi_size);
 
@@ -75,7 +82,8 @@ void iavf_clean_tx_ring(struct iavf_ring *tx_ring)
 	tx_ring->next_to_use = 0;
 	tx_ring->next_to_clean = 0;
 
-	if (!tx_ring->netdev)
+	/* XDP Tx rings are not backed by a netdev Tx queue */
+	if (!tx_ring->netdev || ring_is_xdp(tx_ring))
 		return;
 
 	/* cleanup Tx queue statistics */
@@ -90,10 +98,19 @@ void iavf_clean_tx_ring(struct iavf_ring *tx_ring)
  **/
 void iavf_free_tx_resources(struct iavf_ring *tx_ring)
 {
+	if (ring_defers_doorbell(tx_ring))
+		hrtimer_cancel(&tx_ring->db_timer);
 	iavf_clean_tx_ring(tx_ring);
 	kfree(tx_ring->tx_bi);
 	tx_ring->tx_bi = NULL;
 
+	if (tx_ring->tx_bounce) {
+		dma_free_coherent(tx_ring->dev,
+				  tx_ring->count * IAVF_TX_BOUNCE_SLOT,
+				  tx_ring->tx_bounce, tx_ring->tx_bounce_dma);
+		tx_ring->tx_bounce = NULL;
+	}
+
 	if (tx_ring->desc) {
 		dma_free_coherent(tx_ring->dev, tx_ring->size,
 				  tx_ring->desc, tx_ring->dma);
@@ -107,13 +124,17 @@ void iavf_free_tx_resources(struct iavf_ring *tx_ring)
  * @in_sw: use SW variables
  *
  * Since there is no access to the ring head register
- * in XL710, we need to use our local copies
+ * in XL710, we need to use our local copies, or the head
+ * writeback location if the ring has one
  **/
 u32 iavf_get_tx_pending(struct iavf_ring *ring, bool in_sw)
 {
 	u32 head, tail;
 
-	head = ring->next_to_clean;
+	if (!in_sw && ring_uses_head_wb(ring))
+		head = iavf_get_head(ring);
+	else
+		head = ring->next_to_clean;
 	tail = readl(ring->tail);
 
 	if (head != tail)
@@ -260,6 +281,51 @@ static void iavf_chnl_queue_stats(struct iavf_ring *ring, u64 pkts)
 }
 #define WB_STRIDE 4
 
+/**
+ * iavf_tx_work_limit - Pick the Tx cleanup budget of a ring
+ * @tx_ring: Tx ring about to be cleaned
+ *
+ * The configured limit suits a lightly loaded ring. Once more than half of
+ * the ring is in flight, or the queue had to be stopped since the last
+ * cleanup, everything in flight may be reclaimed so transmit doesn't stall
+ * behind completions the hardware already wrote back.
+ **/
+static unsigned int iavf_tx_work_limit(struct iavf_ring *tx_ring)
+{
+	unsigned int used = tx_ring->count - IAVF_DESC_UNUSED(tx_ring);
+	unsigned int limit = tx_ring->work_limit;
+	u64 stops;
+
+	stops = tx_ring->tx_stats.tx_busy + tx_ring->tx_stats.restart_queue;
+	if (used <= tx_ring->count / 2 &&
+	    stops == tx_ring->tx_stats.prev_stops)
+		return limit;
+
+	tx_ring->tx_stats.prev_stops = stops;
+	if (used > limit) {
+		tx_ring->tx_stats.tx_work_boost++;
+		limit = used;
+	}
+
+	return limit;
+}
+
+/**
+ * iavf_tx_tstamp - report the completion time of a packet
+ * @tx_ring: ring the packet went out on
+ * @skb: packet that asked for a software Tx timestamp
+ *
+ * The PF doesn't let the VF read its Tx timestamp registers, so this is a
+ * software stamp, taken from the system clock as the completion is seen.
+ * Unlike the stamp of skb_tx_timestamp(), it covers the time spent in the
+ * ring and on DMA.
+ **/
+static void iavf_tx_tstamp(struct iavf_ring *tx_ring, struct sk_buff *skb)
+{
+	skb_tstamp_tx(skb, NULL);
+	tx_ring->tx_stats.tx_tstamp++;
+}
+
 /**
  * iavf_clean_tx_irq - Reclaim resources after transmit completes
  * @vsi: the VSI we care about
@@ -272,13 +338,26 @@ static bool iavf_clean_tx_irq(struct iavf_vsi *vsi,
 			      struct iavf_ring *tx_ring, int napi_budget)
 {
 	int i = tx_ring->next_to_clean;
+	struct iavf_tx_desc *tx_head = NULL;
 	struct iavf_tx_buffer *tx_buf;
 	struct iavf_tx_desc *tx_desc;
 	unsigned int total_bytes = 0, total_packets = 0;
-	unsigned int budget = vsi->work_limit;
+	unsigned int budget = iavf_tx_work_limit(tx_ring);
+#ifdef HAVE_XDP_FRAME_BULK
+	struct xdp_frame_bulk bq;
+
+	/* frames go back to their memory model in batches, whose lookup
+	 * must happen under RCU
+	 */
+	xdp_frame_bulk_init(&bq);
+	if (ring_is_xdp(tx_ring))
+		rcu_read_lock();
+#endif /* HAVE_XDP_FRAME_BULK */
 
 	tx_buf = &tx_ring->tx_bi[i];
 	tx_desc = IAVF_TX_DESC(tx_ring, i);
+	if (ring_uses_head_wb(tx_ring))
+		tx_head = IAVF_TX_DESC(tx_ring, iavf_get_head(tx_ring));
 	i -= tx_ring->count;
 
 	do {
@@ -292,9 +371,8 @@ static bool iavf_clean_tx_irq(struct iavf_vsi *vsi,
 		read_barrier_depends();
 
 		iavf_trace(clean_tx_irq, tx_ring, tx_desc, tx_buf);
-		/* if the descriptor isn't done, no work yet to do */
-		if (!(eop_desc->cmd_type_offset_bsz &
-		      cpu_to_le64(IAVF_TX_DESC_DTYPE_DESC_DONE)))
+		/* if the packet isn't done, no work yet to do */
+		if (!iavf_tx_done(tx_ring, &tx_head, tx_desc, eop_desc))
 			break;
 
 		/* clear next_to_watch to prevent false hangs */
@@ -305,13 +383,30 @@ static bool iavf_clean_tx_irq(struct iavf_vsi *vsi,
 		total_packets += tx_buf->gso_segs;
 
 		/* free the skb/XDP data */
+#ifdef HAVE_XDP_SUPPORT
+		if (ring_is_xdp(tx_ring))
+#ifdef HAVE_XDP_FRAME_BULK
+			xdp_return_frame_bulk(tx_buf->xdpf, &bq);
+#elif defined(HAVE_XDP_FRAME_STRUCT)
+			xdp_return_frame(tx_buf->xdpf);
+#else
+			page_frag_free(tx_buf->raw_buf);
+#endif
+		else
+#endif /* HAVE_XDP_SUPPORT */
+		{
+			if (unlikely(tx_buf->tx_flags &
+				     IAVF_TX_FLAGS_TSTAMP_COMPL))
+				iavf_tx_tstamp(tx_ring, tx_buf->skb);
 			napi_consume_skb(tx_buf->skb, napi_budget);
+		}
 
-		/* unmap skb header data */
-		dma_unmap_single(tx_ring->dev,
-				 dma_unmap_addr(tx_buf, dma),
-				 dma_unmap_len(tx_buf, len),
-				 DMA_TO_DEVICE);
+		/* unmap skb header data, unless it went out of a bounce slot */
+		if (!(tx_buf->tx_flags & IAVF_TX_FLAGS_BOUNCE))
+			dma_unmap_single(tx_ring->dev,
+					 dma_unmap_addr(tx_buf, dma),
+					 dma_unmap_len(tx_buf, len),
+					 DMA_TO_DEVICE);
 
 		/* clear tx_buffer data */
 		tx_buf->skb = NULL;
@@ -357,6 +452,16 @@ static bool iavf_clean_tx_irq(struct iavf_vsi *vsi,
 		budget--;
 	} while (likely(budget));
 
+	if (unlikely(!budget))
+		tx_ring->tx_stats.tx_work_exhausted++;
+
+#ifdef HAVE_XDP_FRAME_BULK
+	if (ring_is_xdp(tx_ring)) {
+		xdp_flush_frame_bulk(&bq);
+		rcu_read_unlock();
+	}
+#endif /* HAVE_XDP_FRAME_BULK */
+
 	i += tx_ring->count;
 	tx_ring->next_to_clean = i;
 	u64_stats_update_begin(&tx_ring->syncp);
@@ -703,6 +808,95 @@ clear_counts:
 	rc->total_packets = 0;
 }
 
+#ifdef HAVE_DIM
+/* ITR in usecs for each DIM level of the latency, balanced and throughput
+ * profiles.  Values must be even as the register has 2 usec resolution.
+ */
+static const u16 iavf_dim_itr[][NET_DIM_PARAMS_NUM_PROFILES] = {
+	{ 2, 8, 16, 32, 64 },
+	{ 4, 20, 50, 84, 126 },
+	{ 10, 50, 84, 126, 250 },
+};
+
+/**
+ * iavf_dim_profile - Get the DIM profile picked through the private flags
+ * @adapter: board private structure
+ *
+ * Returns the row of iavf_dim_itr to use, or -1 if the legacy
+ * iavf_update_itr() heuristic is in use
+ **/
+static int iavf_dim_profile(struct iavf_adapter *adapter)
+{
+	u32 flags = READ_ONCE(adapter->flags);
+
+	if (flags & IAVF_FLAG_DIM_LATENCY)
+		return 0;
+	if (flags & IAVF_FLAG_DIM_BALANCED)
+		return 1;
+	if (flags & IAVF_FLAG_DIM_THROUGHPUT)
+		return 2;
+
+	return -1;
+}
+
+/**
+ * iavf_dim_work - Apply a moderation decision made by DIM
+ * @work: work item embedded in the container's DIM state
+ *
+ * Only records the new target ITR; iavf_update_enable_itr() writes it to
+ * the register on the next interrupt, as it does for the legacy heuristic.
+ **/
+void iavf_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct iavf_ring_container *rc =
+		container_of(dim, struct iavf_ring_container, dim);
+	struct iavf_q_vector *q_vector = dim->priv;
+	int profile = iavf_dim_profile(q_vector->adapter);
+
+	/* the engine or adaptive mode may have been turned off meanwhile */
+	if (profile >= 0 && rc->ring &&
+	    ITR_IS_DYNAMIC(rc->ring->itr_setting)) {
+		WRITE_ONCE(rc->target_itr,
+			   iavf_dim_itr[profile][dim->profile_ix]);
+		if (iavf_container_is_rx(q_vector, rc))
+			q_vector->itr_stats.rx_dim_moves++;
+		else
+			q_vector->itr_stats.tx_dim_moves++;
+	}
+
+	dim->state = DIM_START_MEASURE;
+}
+
+/**
+ * iavf_net_dim - Feed the traffic seen by a container to DIM
+ * @q_vector: structure containing interrupt and ring information
+ * @rc: structure containing ring performance data
+ **/
+static void iavf_net_dim(struct iavf_q_vector *q_vector,
+			 struct iavf_ring_container *rc)
+{
+	struct dim_sample sample = {};
+	u64 packets = 0, bytes = 0;
+	struct iavf_ring *ring;
+
+	if (!rc->ring || !ITR_IS_DYNAMIC(rc->ring->itr_setting))
+		return;
+
+	/* DIM works on running totals, which the ring stats already are */
+	iavf_for_each_ring(ring, *rc) {
+		packets += ring->stats.packets;
+		bytes += ring->stats.bytes;
+	}
+
+	dim_update_sample(q_vector->total_events, packets, bytes, &sample);
+	net_dim(&rc->dim, sample);
+
+	rc->total_bytes = 0;
+	rc->total_packets = 0;
+}
+
+#endif /* HAVE_DIM */
 /**
  * iavf_reuse_rx_page - page flip buffer and store it back on the ring
  * @rx_ring: rx descriptor ring to store buffers on
@@ -729,6 +923,110 @@ static void iavf_reuse_rx_page(struct iavf_ring *rx_ring,
 	new_buff->pagecnt_bias	= old_buff->pagecnt_bias;
 }
 
+/**
+ * iavf_tx_db_write - write the Tx tail
+ * @tx_ring: ring to notify the HW for
+ * @i: new tail, the descriptor following the last one placed
+ **/
+static void iavf_tx_db_write(struct iavf_ring *tx_ring, u16 i)
+{
+	tx_ring->db_tail = i;
+	tx_ring->tx_stats.tx_doorbell++;
+	writel(i, tx_ring->tail);
+}
+
+/**
+ * iavf_tx_db_defer - decide whether to hold back a Tx tail write
+ * @tx_ring: ring the packet was placed on
+ *
+ * With doorbell coalescing on, every tail write is an MMIO exit we'd rather
+ * batch.  The write is held back until IAVF_TX_DB_BATCH descriptors are
+ * pending; the next NAPI poll or, at the latest, the timer armed here does it
+ * otherwise.  A stopped queue always gets its tail, so the HW drains it.
+ *
+ * Returns true if the caller must not write the tail now.
+ **/
+static bool iavf_tx_db_defer(struct iavf_ring *tx_ring)
+{
+	int pending;
+
+	if (!ring_defers_doorbell(tx_ring) ||
+	    netif_xmit_stopped(txring_txq(tx_ring)))
+		return false;
+
+	pending = tx_ring->next_to_use - tx_ring->db_tail;
+	if (pending < 0)
+		pending += tx_ring->count;
+	if (pending >= IAVF_TX_DB_BATCH)
+		return false;
+
+	/* the timer runs from the first held back write, later ones don't
+	 * push it out
+	 */
+	if (!hrtimer_is_queued(&tx_ring->db_timer))
+		hrtimer_start(&tx_ring->db_timer,
+			      ns_to_ktime(IAVF_TX_DB_USECS * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	tx_ring->tx_stats.tx_db_deferred++;
+
+	return true;
+}
+
+/**
+ * iavf_tx_db_flush - write a Tx tail held back for coalescing
+ * @tx_ring: ring to flush
+ *
+ * Called from NAPI, so the doorbell rides on a poll that runs anyway.  The
+ * tail may only be written between packets, hence the Tx queue lock.
+ **/
+static void iavf_tx_db_flush(struct iavf_ring *tx_ring)
+{
+	struct netdev_queue *txq;
+
+	if (!ring_defers_doorbell(tx_ring) ||
+	    READ_ONCE(tx_ring->db_tail) == READ_ONCE(tx_ring->next_to_use))
+		return;
+
+	txq = txring_txq(tx_ring);
+	/* whoever holds the lock either writes the tail or we come back
+	 * once the timer fires
+	 */
+	if (!__netif_tx_trylock(txq)) {
+		if (!hrtimer_is_queued(&tx_ring->db_timer))
+			hrtimer_start(&tx_ring->db_timer,
+				      ns_to_ktime(IAVF_TX_DB_USECS *
+						  NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		return;
+	}
+
+	if (tx_ring->db_tail != tx_ring->next_to_use) {
+		iavf_tx_db_write(tx_ring, tx_ring->next_to_use);
+		tx_ring->tx_stats.tx_db_napi++;
+#ifndef SPIN_UNLOCK_IMPLIES_MMIOWB
+		mmiowb();
+#endif /* SPIN_UNLOCK_IMPLIES_MMIOWB */
+	}
+	__netif_tx_unlock(txq);
+}
+
+/**
+ * iavf_tx_db_timer - bound the time a Tx tail write is held back
+ * @timer: db_timer of the ring
+ *
+ * Runs in hard interrupt context, the write itself is left to NAPI.
+ **/
+static enum hrtimer_restart iavf_tx_db_timer(struct hrtimer *timer)
+{
+	struct iavf_ring *tx_ring = container_of(timer, struct iavf_ring,
+						 db_timer);
+
+	tx_ring->tx_stats.tx_db_timer++;
+	napi_schedule(&tx_ring->q_vector->napi);
+
+	return HRTIMER_NORESTART;
+}
+
 /**
  * iavf_setup_tx_descriptors - Allocate the Tx descriptors
  * @tx_ring: the tx ring to set up
@@ -743,15 +1041,24 @@ int iavf_setup_tx_descriptors(struct iavf_ring *tx_ring)
 	if (!dev)
 		return -ENOMEM;
 
+	hrtimer_init(&tx_ring->db_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	tx_ring->db_timer.function = iavf_tx_db_timer;
+
 	/* warn if we are about to overwrite the pointer */
 	WARN_ON(tx_ring->tx_bi);
 	bi_size = sizeof(struct iavf_tx_buffer) * tx_ring->count;
-	tx_ring->tx_bi = kzalloc(bi_size, GFP_KERNEL);
+	tx_ring->tx_bi = kzalloc_node(bi_size, GFP_KERNEL,
+				      iavf_ring_node(tx_ring));
 	if (!tx_ring->tx_bi)
 		goto err;
 
 	/* round up to nearest 4K */
 	tx_ring->size = tx_ring->count * sizeof(struct iavf_tx_desc);
+	/* add u32 for head writeback, align after this takes care of
+	 * guaranteeing this is at least one cache line in size
+	 */
+	if (ring_uses_head_wb(tx_ring))
+		tx_ring->size += sizeof(u32);
 	tx_ring->size = ALIGN(tx_ring->size, 4096);
 	tx_ring->desc = dma_alloc_coherent(dev, tx_ring->size,
 					   &tx_ring->dma, GFP_KERNEL);
@@ -763,7 +1070,25 @@ int iavf_setup_tx_descriptors(struct iavf_ring *tx_ring)
 
 	tx_ring->next_to_use = 0;
 	tx_ring->next_to_clean = 0;
+	tx_ring->db_tail = 0;
 	tx_ring->tx_stats.prev_pkt_ctr = -1;
+
+	/* small packets are copied into pre-mapped slots, one per
+	 * descriptor, rather than mapped and unmapped one by one
+	 */
+	WARN_ON(tx_ring->tx_bounce);
+	if (tx_ring->tx_copybreak && !ring_is_xdp(tx_ring)) {
+		tx_ring->tx_bounce =
+			dma_alloc_coherent(dev,
+					   tx_ring->count * IAVF_TX_BOUNCE_SLOT,
+					   &tx_ring->tx_bounce_dma, GFP_KERNEL);
+		if (!tx_ring->tx_bounce) {
+			dev_info(dev, "Unable to allocate Tx bounce buffers for queue %d, copybreak disabled\n",
+				 tx_ring->queue_index);
+			tx_ring->tx_copybreak = 0;
+		}
+	}
+
 	return 0;
 
 err:
@@ -772,6 +1097,26 @@ err:
 	return -ENOMEM;
 }
 
+/**
+ * iavf_rx_page_cache_drain - Release the pages held in a ring's page cache
+ * @rx_ring: ring owning the cache
+ **/
+static void iavf_rx_page_cache_drain(struct iavf_ring *rx_ring)
+{
+	struct iavf_rx_page_cache *cache = rx_ring->page_cache;
+
+	for (; cache->head != cache->tail; cache->head++) {
+		struct iavf_rx_buffer *bi;
+
+		bi = &cache->bufs[cache->head & cache->mask];
+		dma_unmap_page_attrs(rx_ring->dev, bi->dma,
+				     iavf_rx_pg_size(rx_ring),
+				     DMA_FROM_DEVICE, IAVF_RX_DMA_ATTR);
+		__page_frag_cache_drain(bi->page, bi->pagecnt_bias);
+		bi->page = NULL;
+	}
+}
+
 /**
  * iavf_clean_rx_ring - Free Rx buffers
  * @rx_ring: ring to be cleaned
@@ -790,6 +1135,13 @@ void iavf_clean_rx_ring(struct iavf_ring *rx_ring)
 		rx_ring->skb = NULL;
 	}
 
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	if (rx_ring->xsk_pool) {
+		iavf_xsk_clean_rx_ring(rx_ring);
+		goto skip_free;
+	}
+
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 	/* Free all the Rx ring sk_buffs */
 	for (i = 0; i < rx_ring->count; i++) {
 		struct iavf_rx_buffer *rx_bi = &rx_ring->rx_bi[i];
@@ -797,6 +1149,16 @@ void iavf_clean_rx_ring(struct iavf_ring *rx_ring)
 		if (!rx_bi->page)
 			continue;
 
+#ifdef HAVE_PAGE_POOL
+		if (rx_ring->page_pool) {
+			page_pool_put_page(rx_ring->page_pool, rx_bi->page,
+					   -1, false);
+			rx_bi->page = NULL;
+			rx_bi->page_offset = 0;
+			continue;
+		}
+
+#endif /* HAVE_PAGE_POOL */
 		/* Invalidate cache lines that may have been written to by
 		 * device so that we avoid corrupting memory.
 		 */
@@ -818,6 +1180,12 @@ void iavf_clean_rx_ring(struct iavf_ring *rx_ring)
 		rx_bi->page_offset = 0;
 	}
 
+	if (rx_ring->page_cache)
+		iavf_rx_page_cache_drain(rx_ring);
+
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+skip_free:
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 	bi_size = sizeof(struct iavf_rx_buffer) * rx_ring->count;
 	memset(rx_ring->rx_bi, 0, bi_size);
 
@@ -838,6 +1206,25 @@ void iavf_clean_rx_ring(struct iavf_ring *rx_ring)
 void iavf_free_rx_resources(struct iavf_ring *rx_ring)
 {
 	iavf_clean_rx_ring(rx_ring);
+#ifdef HAVE_XDP_BUFF_RXQ
+	if (xdp_rxq_info_is_reg(&rx_ring->xdp_rxq))
+		xdp_rxq_info_unreg(&rx_ring->xdp_rxq);
+#endif /* HAVE_XDP_BUFF_RXQ */
+#ifdef HAVE_PAGE_POOL
+	if (rx_ring->page_pool) {
+		page_pool_destroy(rx_ring->page_pool);
+		rx_ring->page_pool = NULL;
+	}
+#endif /* HAVE_PAGE_POOL */
+	if (rx_ring->hdr_buf) {
+		dma_free_coherent(rx_ring->dev,
+				  rx_ring->count * IAVF_RX_HDR_SIZE,
+				  rx_ring->hdr_buf, rx_ring->hdr_dma);
+		rx_ring->hdr_buf = NULL;
+	}
+	rx_ring->flags &= ~IAVF_RXR_FLAGS_HDR_SPLIT;
+	kfree(rx_ring->page_cache);
+	rx_ring->page_cache = NULL;
 	rx_ring->xdp_prog = NULL;
 	kfree(rx_ring->rx_bi);
 	rx_ring->rx_bi = NULL;
@@ -864,7 +1251,8 @@ int iavf_setup_rx_descriptors(struct iavf_ring *rx_ring)
 	/* warn if we are about to overwrite the pointer */
 	WARN_ON(rx_ring->rx_bi);
 	bi_size = sizeof(struct iavf_rx_buffer) * rx_ring->count;
-	rx_ring->rx_bi = kzalloc(bi_size, GFP_KERNEL);
+	rx_ring->rx_bi = kzalloc_node(bi_size, GFP_KERNEL,
+				      iavf_ring_node(rx_ring));
 	if (!rx_ring->rx_bi)
 		goto err;
 #ifdef HAVE_NDO_GET_STATS64
@@ -873,7 +1261,11 @@ int iavf_setup_rx_descriptors(struct iavf_ring *rx_ring)
 #endif /* HAVE_NDO_GET_STATS64 */
 
 	/* Round up to nearest 4K */
-	rx_ring->size = rx_ring->count * sizeof(union iavf_rx_desc);
+	if (ring_uses_16byte_desc(rx_ring))
+		rx_ring->size = rx_ring->count *
+				sizeof(union iavf_16byte_rx_desc);
+	else
+		rx_ring->size = rx_ring->count * sizeof(union iavf_rx_desc);
 	rx_ring->size = ALIGN(rx_ring->size, 4096);
 	rx_ring->desc = dma_alloc_coherent(dev, rx_ring->size,
 					   &rx_ring->dma, GFP_KERNEL);
@@ -887,7 +1279,29 @@ int iavf_setup_rx_descriptors(struct iavf_ring *rx_ring)
 	rx_ring->next_to_alloc = 0;
 	rx_ring->next_to_clean = 0;
 	rx_ring->next_to_use = 0;
+	rx_ring->rx_refill_thresh = IAVF_RX_BUFFER_WRITE;
+
+#ifdef HAVE_XDP_BUFF_RXQ
+#ifdef HAVE_XDP_RXQ_INFO_REG_3_PARAMS
+	err = xdp_rxq_info_reg(&rx_ring->xdp_rxq, rx_ring->netdev,
+			       rx_ring->queue_index);
+#else
+	err = xdp_rxq_info_reg(&rx_ring->xdp_rxq, rx_ring->netdev,
+			       rx_ring->queue_index,
+			       rx_ring->q_vector->napi.napi_id);
+#endif /* HAVE_XDP_RXQ_INFO_REG_3_PARAMS */
+	if (err < 0)
+		goto err_desc;
+
+#endif /* HAVE_XDP_BUFF_RXQ */
+	rx_ring->xdp_prog = rx_ring->vsi->xdp_prog;
+
 	return 0;
+#ifdef HAVE_XDP_BUFF_RXQ
+err_desc:
+	dma_free_coherent(dev, rx_ring->size, rx_ring->desc, rx_ring->dma);
+	rx_ring->desc = NULL;
+#endif /* HAVE_XDP_BUFF_RXQ */
 err:
 	kfree(rx_ring->rx_bi);
 	rx_ring->rx_bi = NULL;
@@ -895,47 +1309,223 @@ err:
 }
 
 /**
- * iavf_release_rx_desc - Store the new tail and head values
- * @rx_ring: ring to bump
- * @val: new head index
+ * iavf_rx_offset - Return expected offset into page to access data
+ * @rx_ring: Ring we are requesting offset of
+ *
+ * Returns the offset value for ring into the data buffer.
+ */
+static inline unsigned int iavf_rx_offset(struct iavf_ring *rx_ring)
+{
+	return ring_uses_build_skb(rx_ring) ? IAVF_SKB_PAD : 0;
+}
+
+/**
+ * iavf_setup_rx_hdr_split - Enable header split on an Rx ring
+ * @rx_ring: Rx ring, with its buffer length already configured
+ *
+ * Allocates the per-ring header buffer, one IAVF_RX_HDR_SIZE slot per
+ * descriptor.  The packet buffers of a split ring only carry payload, so
+ * it starts at the beginning of the buffer and the skb is built around a
+ * copy of the header.  Rings running an XDP program are left unsplit as
+ * the program needs the whole frame in one buffer.
+ *
+ * Returns 0 on success, negative on failure; the ring is left unsplit on
+ * failure.
  **/
-static inline void iavf_release_rx_desc(struct iavf_ring *rx_ring, u32 val)
+int iavf_setup_rx_hdr_split(struct iavf_ring *rx_ring)
 {
-	rx_ring->next_to_use = val;
+	if (rx_ring->xdp_prog)
+		return 0;
 
-	/* update next to alloc since we have filled the ring */
-	rx_ring->next_to_alloc = val;
+	/* warn if we are about to overwrite the pointer */
+	WARN_ON(rx_ring->hdr_buf);
+	rx_ring->hdr_buf = dma_alloc_coherent(rx_ring->dev,
+					      rx_ring->count * IAVF_RX_HDR_SIZE,
+					      &rx_ring->hdr_dma, GFP_KERNEL);
+	if (!rx_ring->hdr_buf) {
+		dev_info(rx_ring->dev, "Unable to allocate header buffers for Rx queue %d, header split disabled\n",
+			 rx_ring->queue_index);
+		return -ENOMEM;
+	}
 
-	/* Force memory writes to complete before letting h/w
-	 * know there are new descriptors to fetch.  (Only
-	 * applicable for weak-ordered memory model archs,
-	 * such as IA-64).
-	 */
-	wmb();
-	writel(val, rx_ring->tail);
+	clear_ring_build_skb_enabled(rx_ring);
+	rx_ring->flags |= IAVF_RXR_FLAGS_HDR_SPLIT;
+
+	return 0;
 }
 
 /**
- * iavf_rx_offset - Return expected offset into page to access data
- * @rx_ring: Ring we are requesting offset of
+ * iavf_setup_rx_page_cache - Keep the DMA mappings of an Rx ring's pages
+ * @rx_ring: Rx ring, with its buffer length already configured
  *
- * Returns the offset value for ring into the data buffer.
- */
-static inline unsigned int iavf_rx_offset(struct iavf_ring *rx_ring)
+ * A page the ring can't flip because the stack still holds the other half
+ * is normally unmapped and released.  With the cache it is parked, still
+ * mapped, until the stack lets go of it and is then handed back to the
+ * ring, saving a map/unmap pair per page.  That pair is an IOMMU update
+ * and an IOTLB invalidation when the VF sits behind a vIOMMU.  The cache
+ * holds as many pages as the ring has descriptors, rounded up to a power
+ * of 2.  Rings backed by a page_pool or a umem already keep their mappings
+ * and don't get a cache.
+ *
+ * Returns 0 on success, negative on failure; the ring runs uncached on
+ * failure.
+ **/
+int iavf_setup_rx_page_cache(struct iavf_ring *rx_ring)
 {
-	return ring_uses_build_skb(rx_ring) ? IAVF_SKB_PAD : 0;
+	struct iavf_rx_page_cache *cache;
+	u32 entries;
+
+#ifdef HAVE_PAGE_POOL
+	if (rx_ring->page_pool)
+		return 0;
+#endif /* HAVE_PAGE_POOL */
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	if (rx_ring->xsk_pool)
+		return 0;
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+
+	/* warn if we are about to overwrite the pointer */
+	WARN_ON(rx_ring->page_cache);
+	entries = roundup_pow_of_two(rx_ring->count);
+	cache = kzalloc_node(struct_size(cache, bufs, entries), GFP_KERNEL,
+			     iavf_ring_node(rx_ring));
+	if (!cache) {
+		dev_info(rx_ring->dev, "Unable to allocate page cache for Rx queue %d\n",
+			 rx_ring->queue_index);
+		return -ENOMEM;
+	}
+
+	cache->mask = entries - 1;
+	rx_ring->page_cache = cache;
+
+	return 0;
+}
+
+#ifdef HAVE_PAGE_POOL
+/**
+ * iavf_setup_rx_page_pool - Back an Rx ring with a page_pool
+ * @rx_ring: Rx ring, with its buffer length already configured
+ *
+ * The pool owns the DMA mapping of the pages and syncs them for the device
+ * when they are recycled, so buffers keep being reused even when they come
+ * back out of order.  Each buffer takes a whole page in this mode.
+ *
+ * Returns 0 on success, negative on failure; the ring keeps using the
+ * regular page recycling on failure.
+ **/
+int iavf_setup_rx_page_pool(struct iavf_ring *rx_ring)
+{
+	struct page_pool_params pp_params = { 0 };
+	struct page_pool *pool;
+	int err;
+
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	/* zero-copy rings get their buffers from the AF_XDP pool */
+	if (rx_ring->xsk_pool)
+		return 0;
+
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+	pp_params.order = iavf_rx_pg_order(rx_ring);
+	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+	pp_params.pool_size = rx_ring->count;
+	pp_params.nid = iavf_ring_node(rx_ring);
+	pp_params.dev = rx_ring->dev;
+	pp_params.dma_dir = DMA_FROM_DEVICE;
+	pp_params.offset = iavf_rx_offset(rx_ring);
+	pp_params.max_len = rx_ring->rx_buf_len;
+
+	pool = page_pool_create(&pp_params);
+	if (IS_ERR(pool)) {
+		err = PTR_ERR(pool);
+		goto err;
+	}
+
+	xdp_rxq_info_unreg_mem_model(&rx_ring->xdp_rxq);
+	err = xdp_rxq_info_reg_mem_model(&rx_ring->xdp_rxq,
+					 MEM_TYPE_PAGE_POOL, pool);
+	if (err) {
+		page_pool_destroy(pool);
+		xdp_rxq_info_reg_mem_model(&rx_ring->xdp_rxq,
+					   MEM_TYPE_PAGE_SHARED, NULL);
+		goto err;
+	}
+
+	rx_ring->page_pool = pool;
+
+	return 0;
+
+err:
+	dev_info(rx_ring->dev, "Unable to create page_pool for Rx queue %d, error %d\n",
+		 rx_ring->queue_index, err);
+	return err;
+}
+
+/**
+ * iavf_rx_pool_mark_skb - Let an skb return its page_pool pages on free
+ * @rx_ring: Rx ring the pages belong to
+ * @skb: skb that now references a page of the ring
+ **/
+static void iavf_rx_pool_mark_skb(struct iavf_ring *rx_ring,
+				  struct sk_buff *skb)
+{
+	if (!rx_ring->page_pool)
+		return;
+
+	/* the page goes back to the pool when the skb is freed */
+	skb_mark_for_recycle(skb);
+}
+
+#endif /* HAVE_PAGE_POOL */
+#define IAVF_RX_GFP (GFP_ATOMIC | __GFP_NOWARN | __GFP_COMP | __GFP_MEMALLOC)
+
+/**
+ * iavf_rx_page_cache_get - Take a released page out of the page cache
+ * @rx_ring: ring to refill
+ * @bi: rx_buffer struct to fill
+ *
+ * Only the oldest page is looked at.  If the stack still holds it, it is
+ * moved to the back of the cache so a single long lived skb can't keep
+ * every other page from being reused.
+ *
+ * Returns true if @bi was filled from the cache
+ **/
+static bool iavf_rx_page_cache_get(struct iavf_ring *rx_ring,
+				   struct iavf_rx_buffer *bi)
+{
+	struct iavf_rx_page_cache *cache = rx_ring->page_cache;
+	struct iavf_rx_buffer *old;
+
+	if (cache->head == cache->tail)
+		return false;
+
+	old = &cache->bufs[cache->head++ & cache->mask];
+	if (page_count(old->page) != old->pagecnt_bias) {
+		/* still held by the stack, requeue it behind the others */
+		cache->bufs[cache->tail++ & cache->mask] = *old;
+		return false;
+	}
+
+	*bi = *old;
+	bi->page_offset = iavf_rx_offset(rx_ring);
+
+	return true;
 }
 
 /**
  * iavf_alloc_mapped_page - recycle or make a new page
  * @rx_ring: ring to use
  * @bi: rx_buffer struct to modify
+ * @new_page: page taken from a bulk allocation, or NULL
+ *
+ * @new_page is only consumed if @bi needs a new page; it is freed on a
+ * mapping failure.
  *
  * Returns true if the page was successfully allocated or
  * reused.
  **/
 static bool iavf_alloc_mapped_page(struct iavf_ring *rx_ring,
-				   struct iavf_rx_buffer *bi)
+				   struct iavf_rx_buffer *bi,
+				   struct page *new_page)
 {
 	struct page *page = bi->page;
 	dma_addr_t dma;
@@ -946,8 +1536,36 @@ static bool iavf_alloc_mapped_page(struct iavf_ring *rx_ring,
 		return true;
 	}
 
-	/* alloc new page for storage */
-	page = dev_alloc_pages(iavf_rx_pg_order(rx_ring));
+#ifdef HAVE_PAGE_POOL
+	if (rx_ring->page_pool) {
+		/* the pool hands out pages mapped and synced for the device */
+		page = page_pool_dev_alloc_pages(rx_ring->page_pool);
+		if (unlikely(!page)) {
+			rx_ring->rx_stats.alloc_page_failed++;
+			return false;
+		}
+
+		bi->dma = page_pool_get_dma_addr(page);
+		bi->page = page;
+		bi->page_offset = iavf_rx_offset(rx_ring);
+		bi->pagecnt_bias = 1;
+
+		return true;
+	}
+
+#endif /* HAVE_PAGE_POOL */
+	if (rx_ring->page_cache) {
+		if (iavf_rx_page_cache_get(rx_ring, bi)) {
+			rx_ring->rx_stats.page_cache_hit++;
+			return true;
+		}
+		rx_ring->rx_stats.page_cache_miss++;
+	}
+
+	/* alloc new page for storage on the node servicing the ring */
+	page = new_page ? : alloc_pages_node(iavf_ring_node(rx_ring),
+					     IAVF_RX_GFP,
+					     iavf_rx_pg_order(rx_ring));
 	if (unlikely(!page)) {
 		rx_ring->rx_stats.alloc_page_failed++;
 		return false;
@@ -978,31 +1596,16 @@ static bool iavf_alloc_mapped_page(struct iavf_ring *rx_ring,
 	return true;
 }
 
+#ifndef HAVE_VLAN_RX_REGISTER
 /**
- * iavf_receive_skb - Send a completed packet up the stack
+ * iavf_rx_vlan - Attach the stripped VLAN tag to a packet
  * @rx_ring:  rx ring in play
- * @skb: packet to send up
+ * @skb: packet to tag
  * @vlan_tag: vlan tag for packet
  **/
-static void iavf_receive_skb(struct iavf_ring *rx_ring,
-			     struct sk_buff *skb, u16 vlan_tag)
+static void iavf_rx_vlan(struct iavf_ring *rx_ring, struct sk_buff *skb,
+			 u16 vlan_tag)
 {
-	struct iavf_q_vector *q_vector = rx_ring->q_vector;
-#ifdef HAVE_VLAN_RX_REGISTER
-	struct iavf_vsi *vsi = rx_ring->vsi;
-#endif
-
-#ifdef HAVE_VLAN_RX_REGISTER
-	if (vlan_tag & VLAN_VID_MASK) {
-		if (!vsi->vlgrp)
-			dev_kfree_skb_any(skb);
-		else
-			vlan_gro_receive(&q_vector->napi, vsi->vlgrp,
-					 vlan_tag, skb);
-	} else {
-		napi_gro_receive(&q_vector->napi, skb);
-	}
-#else /* HAVE_VLAN_RX_REGISTER */
 #ifdef NETIF_F_HW_VLAN_CTAG_RX
 	if ((rx_ring->netdev->features & NETIF_F_HW_VLAN_CTAG_RX) &&
 	    (vlan_tag & VLAN_VID_MASK))
@@ -1021,11 +1624,132 @@ static void iavf_receive_skb(struct iavf_ring *rx_ring,
 #endif /* NETIF_F_HW_VLAN_CTAG_RX */
 		rx_ring->vsi->back->rx_vlano++;
 #endif /* IAVF_ADD_PROBES */
+}
 
+#endif /* !HAVE_VLAN_RX_REGISTER */
+/**
+ * iavf_receive_skb - Send a completed packet up the stack
+ * @rx_ring:  rx ring in play
+ * @skb: packet to send up
+ * @vlan_tag: vlan tag for packet
+ **/
+void iavf_receive_skb(struct iavf_ring *rx_ring, struct sk_buff *skb,
+		      u16 vlan_tag)
+{
+	struct iavf_q_vector *q_vector = rx_ring->q_vector;
+#ifdef HAVE_VLAN_RX_REGISTER
+	struct iavf_vsi *vsi = rx_ring->vsi;
+#endif
+
+#ifdef HAVE_VLAN_RX_REGISTER
+	if (vlan_tag & VLAN_VID_MASK) {
+		if (!vsi->vlgrp)
+			dev_kfree_skb_any(skb);
+		else
+			vlan_gro_receive(&q_vector->napi, vsi->vlgrp,
+					 vlan_tag, skb);
+	} else {
+		napi_gro_receive(&q_vector->napi, skb);
+	}
+#else /* HAVE_VLAN_RX_REGISTER */
+	iavf_rx_vlan(rx_ring, skb, vlan_tag);
 	napi_gro_receive(&q_vector->napi, skb);
 #endif /* HAVE_VLAN_RX_REGISTER */
 }
 
+#ifdef HAVE_NETIF_RECEIVE_SKB_LIST
+/**
+ * iavf_receive_skb_list - Send a batch of completed packets up the stack
+ * @rx_ring:  rx ring in play
+ * @rx_list: packets to send up, in the order they were received
+ *
+ * Only without GRO is the batch handed to the stack in one call.  GRO has
+ * no list entry point, so with GRO enabled the packets still go through
+ * napi_gro_receive() one at a time, just once the whole batch has been
+ * pulled off the ring; the core then batches the packets GRO didn't merge
+ * on its own napi list.
+ *
+ * Returns true if the batch went up as a list
+ **/
+static bool iavf_receive_skb_list(struct iavf_ring *rx_ring,
+				  struct list_head *rx_list)
+{
+	struct napi_struct *napi = &rx_ring->q_vector->napi;
+	struct sk_buff *skb, *next;
+
+	if (!(rx_ring->netdev->features & NETIF_F_GRO)) {
+		netif_receive_skb_list(rx_list);
+		return true;
+	}
+
+	list_for_each_entry_safe(skb, next, rx_list, list) {
+		list_del(&skb->list);
+		/* the stack expects the skb off any list */
+		skb->next = NULL;
+		napi_gro_receive(napi, skb);
+	}
+
+	return false;
+}
+
+#endif /* HAVE_NETIF_RECEIVE_SKB_LIST */
+
+/**
+ * iavf_rx_can_bulk_alloc - Check if a ring's pages can be bulk allocated
+ * @rx_ring: ring to check
+ *
+ * The bulk allocator only hands out order-0 pages, page_pool rings
+ * already refill their cache in bulk and page cache rings refill from
+ * pages they already mapped.
+ **/
+static bool iavf_rx_can_bulk_alloc(struct iavf_ring *rx_ring)
+{
+#ifdef HAVE_ALLOC_PAGES_BULK
+#ifdef HAVE_PAGE_POOL
+	if (rx_ring->page_pool)
+		return false;
+#endif /* HAVE_PAGE_POOL */
+	/* cached pages would be preferred over the bulk allocated ones */
+	if (rx_ring->page_cache)
+		return false;
+	return !iavf_rx_pg_order(rx_ring);
+#else
+	return false;
+#endif /* HAVE_ALLOC_PAGES_BULK */
+}
+
+/**
+ * iavf_rx_alloc_pages_bulk - Allocate the pages for the next empty slots
+ * @rx_ring: ring to allocate for
+ * @pages: array of IAVF_RX_BULK_ALLOC entries to fill
+ * @ntu: first slot being refilled
+ * @count: number of slots being refilled
+ *
+ * Most slots still hold a recycled page, so only the slots without one are
+ * counted, up to IAVF_RX_BULK_ALLOC of them, and allocated in one call.
+ *
+ * Returns the number of pages placed in @pages
+ **/
+static u16 iavf_rx_alloc_pages_bulk(struct iavf_ring *rx_ring,
+				    struct page **pages, u16 ntu, u16 count)
+{
+#ifdef HAVE_ALLOC_PAGES_BULK
+	u16 nr = 0;
+
+	while (count-- && nr < IAVF_RX_BULK_ALLOC) {
+		if (!rx_ring->rx_bi[ntu].page)
+			pages[nr++] = NULL;
+		if (unlikely(++ntu == rx_ring->count))
+			ntu = 0;
+	}
+
+	return alloc_pages_bulk_array_node(IAVF_RX_GFP,
+					   iavf_ring_node(rx_ring), nr, pages);
+#else
+	return 0;
+#endif /* HAVE_ALLOC_PAGES_BULK */
+}
+
 /**
  * iavf_alloc_rx_buffers - Replace used receive buffers
  * @rx_ring: ring to place buffers on
@@ -1035,40 +1759,74 @@ static void iavf_receive_skb(struct iavf_ring *rx_ring,
  **/
 bool iavf_alloc_rx_buffers(struct iavf_ring *rx_ring, u16 cleaned_count)
 {
+	struct page *pages[IAVF_RX_BULK_ALLOC];
 	u16 ntu = rx_ring->next_to_use;
+	u16 nr_pages = 0, page_idx = 0;
 	union iavf_rx_desc *rx_desc;
 	struct iavf_rx_buffer *bi;
+	bool bulk;
 
 	/* do nothing if no valid netdev defined */
 	if (!rx_ring->netdev || !cleaned_count)
 		return false;
 
+#ifdef HAVE_PAGE_POOL
+	/* follow the vector if its IRQ moved to another node */
+	if (rx_ring->page_pool)
+		page_pool_nid_changed(rx_ring->page_pool,
+				      iavf_ring_node(rx_ring));
+
+#endif /* HAVE_PAGE_POOL */
+	bulk = iavf_rx_can_bulk_alloc(rx_ring);
 	rx_desc = IAVF_RX_DESC(rx_ring, ntu);
 	bi = &rx_ring->rx_bi[ntu];
 
 	do {
-		if (!iavf_alloc_mapped_page(rx_ring, bi))
+		struct page *page = NULL;
+
+		if (bulk && !bi->page) {
+			if (page_idx == nr_pages) {
+				nr_pages = iavf_rx_alloc_pages_bulk(rx_ring,
+								    pages,
+								    ntu,
+								    cleaned_count);
+				page_idx = 0;
+			}
+			if (page_idx < nr_pages)
+				page = pages[page_idx++];
+		}
+
+		if (!iavf_alloc_mapped_page(rx_ring, bi, page))
 			goto no_buffers;
 
-		/* sync the buffer for use by the device */
-		dma_sync_single_range_for_device(rx_ring->dev, bi->dma,
-						 bi->page_offset,
-						 rx_ring->rx_buf_len,
-						 DMA_FROM_DEVICE);
+		/* sync the buffer for use by the device, page_pool pages
+		 * were already synced when they went back to the pool
+		 */
+#ifdef HAVE_PAGE_POOL
+		if (!rx_ring->page_pool)
+#endif /* HAVE_PAGE_POOL */
+			dma_sync_single_range_for_device(rx_ring->dev, bi->dma,
+							 bi->page_offset,
+							 rx_ring->rx_buf_len,
+							 DMA_FROM_DEVICE);
 
 		/* Refresh the desc even if buffer_addrs didn't change
 		 * because each write-back erases this info.
 		 */
 		rx_desc->read.pkt_addr = cpu_to_le64(bi->dma + bi->page_offset);
+		if (ring_uses_hdr_split(rx_ring))
+			rx_desc->read.hdr_addr =
+				cpu_to_le64(rx_ring->hdr_dma +
+					    ntu * IAVF_RX_HDR_SIZE);
 
-		rx_desc++;
 		bi++;
 		ntu++;
 		if (unlikely(ntu == rx_ring->count)) {
-			rx_desc = IAVF_RX_DESC(rx_ring, 0);
 			bi = rx_ring->rx_bi;
 			ntu = 0;
 		}
+		/* the descriptor stride depends on the ring's format */
+		rx_desc = IAVF_RX_DESC(rx_ring, ntu);
 
 		/* clear the status bits for the next_to_use descriptor */
 		rx_desc->wb.qword1.status_error_len = 0;
@@ -1082,6 +1840,10 @@ bool iavf_alloc_rx_buffers(struct iavf_ring *rx_ring, u16 cleaned_count)
 	return false;
 
 no_buffers:
+	/* give back whatever the bulk allocation left unused */
+	while (page_idx < nr_pages)
+		__free_pages(pages[page_idx++], iavf_rx_pg_order(rx_ring));
+
 	if (rx_ring->next_to_use != ntu)
 		iavf_release_rx_desc(rx_ring, ntu);
 
@@ -1091,6 +1853,34 @@ no_buffers:
 	return true;
 }
 
+/**
+ * iavf_update_rx_refill_thresh - Adapt the Rx refill watermark
+ * @rx_ring: ring that was cleaned
+ * @cleaned: packets cleaned by the last poll
+ * @budget: budget of the last poll
+ *
+ * While polls keep using their whole budget the ring is draining fast, so
+ * buffers are handed back in bigger chunks to save tail writes and
+ * allocator calls.  Once the rate drops the watermark comes back down so
+ * an idle ring is left well stocked for the next burst.
+ **/
+static void iavf_update_rx_refill_thresh(struct iavf_ring *rx_ring,
+					 unsigned int cleaned, int budget)
+{
+	u16 limit = rounddown(rx_ring->count / 4, IAVF_RX_BUFFER_WRITE);
+	u16 thresh = rx_ring->rx_refill_thresh;
+
+	limit = clamp_t(u16, limit, IAVF_RX_BUFFER_WRITE,
+			IAVF_RX_BUFFER_WRITE_MAX);
+
+	if (cleaned >= (unsigned int)budget)
+		thresh = min_t(u16, thresh * 2, limit);
+	else if (cleaned < thresh)
+		thresh = max_t(u16, thresh / 2, IAVF_RX_BUFFER_WRITE);
+
+	rx_ring->rx_refill_thresh = thresh;
+}
+
 #ifdef IAVF_ADD_PROBES
 static void iavf_rx_extra_counters(struct iavf_vsi *vsi, u32 rx_error,
 				   const struct iavf_rx_ptype_decoded decoded)
@@ -1286,7 +2076,6 @@ static inline void iavf_rx_hash(struct iavf_ring *ring,
  * order to populate the hash, checksum, VLAN, protocol, and
  * other fields within the skb.
  **/
-static inline
 void iavf_process_skb_fields(struct iavf_ring *rx_ring,
 			     union iavf_rx_desc *rx_desc, struct sk_buff *skb,
 			     u8 rx_ptype)
@@ -1437,15 +2226,20 @@ static void iavf_add_rx_frag(struct iavf_ring *rx_ring,
 			     unsigned int size)
 {
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = iavf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = iavf_rx_buf_truesize(rx_ring);
 #else
-	unsigned int truesize =	SKB_DATA_ALIGN(size + iavf_rx_offset(rx_ring));
+	unsigned int truesize = iavf_rx_uses_page_pool(rx_ring) ?
+				iavf_rx_pg_size(rx_ring) :
+				SKB_DATA_ALIGN(size + iavf_rx_offset(rx_ring));
 #endif
 
 	if (!size)
 		return;
 	skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, rx_buffer->page,
 			rx_buffer->page_offset, size, truesize);
+#ifdef HAVE_PAGE_POOL
+	iavf_rx_pool_mark_skb(rx_ring, skb);
+#endif /* HAVE_PAGE_POOL */
 
 	/* page is being used so we must update the page offset */
 #if (PAGE_SIZE < 8192)
@@ -1503,9 +2297,11 @@ static struct sk_buff *iavf_construct_skb(struct iavf_ring *rx_ring,
 	unsigned int size = (u8 *)xdp->data_end - (u8 *)xdp->data;
 
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = iavf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = iavf_rx_buf_truesize(rx_ring);
 #else
-	unsigned int truesize = SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) +
+	unsigned int truesize = iavf_rx_uses_page_pool(rx_ring) ?
+				iavf_rx_pg_size(rx_ring) :
+				SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) +
 				SKB_DATA_ALIGN(IAVF_SKB_PAD + size);
 #endif
 	unsigned int headlen;
@@ -1542,6 +2338,9 @@ static struct sk_buff *iavf_construct_skb(struct iavf_ring *rx_ring,
 		skb_add_rx_frag(skb, 0, rx_buffer->page,
 				rx_buffer->page_offset + headlen,
 				size, truesize);
+#ifdef HAVE_PAGE_POOL
+		iavf_rx_pool_mark_skb(rx_ring, skb);
+#endif /* HAVE_PAGE_POOL */
 
 		/* buffer is used by skb, update page_offset */
 #if (PAGE_SIZE < 8192)
@@ -1557,6 +2356,96 @@ static struct sk_buff *iavf_construct_skb(struct iavf_ring *rx_ring,
 	return skb;
 }
 
+/**
+ * iavf_construct_skb_hdr_split - Allocate skb around a split header
+ * @rx_ring: rx descriptor ring to transact packets on
+ * @rx_buffer: rx buffer holding the payload, NULL if there is none
+ * @hlen: length of the header written to the header buffer
+ * @size: length of the payload in @rx_buffer
+ *
+ * The header is copied out of the ring's header buffer into the linear
+ * part of a new skb and the payload page, if any, is attached as the first
+ * frag without touching its contents.
+ */
+static struct sk_buff *
+iavf_construct_skb_hdr_split(struct iavf_ring *rx_ring,
+			     struct iavf_rx_buffer *rx_buffer,
+			     unsigned int hlen, unsigned int size)
+{
+#if (PAGE_SIZE < 8192)
+	unsigned int truesize = iavf_rx_buf_truesize(rx_ring);
+#else
+	unsigned int truesize = SKB_DATA_ALIGN(size);
+#endif
+	struct sk_buff *skb;
+	u8 *hdr;
+
+	/* the header buffer is coherent memory, no sync needed */
+	hdr = rx_ring->hdr_buf + rx_ring->next_to_clean * IAVF_RX_HDR_SIZE;
+	prefetch(hdr);
+
+	skb = __napi_alloc_skb(&rx_ring->q_vector->napi,
+			       IAVF_RX_HDR_SIZE,
+			       GFP_ATOMIC | __GFP_NOWARN);
+	if (unlikely(!skb))
+		return NULL;
+
+	/* align pull length to size of long to optimize memcpy performance */
+	memcpy(__skb_put(skb, hlen), hdr, ALIGN(hlen, sizeof(long)));
+
+	if (!rx_buffer)
+		return skb;
+
+	skb_add_rx_frag(skb, 0, rx_buffer->page, rx_buffer->page_offset,
+			size, truesize);
+#ifdef HAVE_PAGE_POOL
+	iavf_rx_pool_release_page(rx_ring, skb, rx_buffer->page);
+#endif /* HAVE_PAGE_POOL */
+
+	/* buffer is used by skb, update page_offset */
+#if (PAGE_SIZE < 8192)
+	rx_buffer->page_offset ^= truesize;
+#else
+	rx_buffer->page_offset += truesize;
+#endif
+
+	return skb;
+}
+
+/**
+ * iavf_copybreak_skb - Copy a small frame into a new skb
+ * @rx_ring: rx descriptor ring to transact packets on
+ * @rx_buffer: rx buffer to pull data from
+ * @xdp: xdp_buff pointing to the data
+ *
+ * The whole frame is copied into the linear area of a new skb and the
+ * buffer goes back to the ring as is, the page refcount is never touched.
+ */
+static struct sk_buff *iavf_copybreak_skb(struct iavf_ring *rx_ring,
+					  struct iavf_rx_buffer *rx_buffer,
+					  struct xdp_buff *xdp)
+{
+	unsigned int size = (u8 *)xdp->data_end - (u8 *)xdp->data;
+	struct sk_buff *skb;
+
+	prefetch(xdp->data);
+
+	skb = __napi_alloc_skb(&rx_ring->q_vector->napi,
+			       ALIGN(size, sizeof(long)),
+			       GFP_ATOMIC | __GFP_NOWARN);
+	if (unlikely(!skb))
+		return NULL;
+
+	/* align pull length to size of long to optimize memcpy performance */
+	memcpy(__skb_put(skb, size), xdp->data, ALIGN(size, sizeof(long)));
+
+	/* buffer is unused, reset bias back to rx_buffer */
+	rx_buffer->pagecnt_bias++;
+	rx_ring->rx_stats.copybreak_pkts++;
+
+	return skb;
+}
+
 #ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
 /**
  * iavf_build_skb - Build skb around an existing buffer
@@ -1574,9 +2463,11 @@ static struct sk_buff *iavf_build_skb(struct iavf_ring *rx_ring,
 	unsigned int size = (u8 *)xdp->data_end - (u8 *)xdp->data;
 
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = iavf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = iavf_rx_buf_truesize(rx_ring);
 #else
-	unsigned int truesize = SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) +
+	unsigned int truesize = iavf_rx_uses_page_pool(rx_ring) ?
+				iavf_rx_pg_size(rx_ring) :
+				SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) +
 				SKB_DATA_ALIGN(xdp->data_end -
 					       xdp->data_hard_start);
 #endif
@@ -1598,6 +2489,9 @@ static struct sk_buff *iavf_build_skb(struct iavf_ring *rx_ring,
 	/* update pointers within the skb to store the data */
 	skb_reserve(skb, xdp->data - xdp->data_hard_start);
 	__skb_put(skb, size);
+#ifdef HAVE_PAGE_POOL
+	iavf_rx_pool_mark_skb(rx_ring, skb);
+#endif /* HAVE_PAGE_POOL */
 
 	/* buffer is used by skb, update page_offset */
 #if (PAGE_SIZE < 8192)
@@ -1610,6 +2504,38 @@ static struct sk_buff *iavf_build_skb(struct iavf_ring *rx_ring,
 }
 
 #endif /* HAVE_SWIOTLB_SKIP_CPU_SYNC */
+/**
+ * iavf_rx_page_cache_put - Park a page the ring can't reuse yet
+ * @rx_ring: ring the page belongs to
+ * @rx_buffer: buffer holding the page
+ *
+ * The page stays mapped and the driver keeps its references to it, so it
+ * can go back on the ring once the stack is done with it.
+ *
+ * Returns true if the page went into the cache
+ **/
+static bool iavf_rx_page_cache_put(struct iavf_ring *rx_ring,
+				   struct iavf_rx_buffer *rx_buffer)
+{
+	struct iavf_rx_page_cache *cache = rx_ring->page_cache;
+
+	if (!cache || cache->tail - cache->head > cache->mask)
+		return false;
+
+	if (unlikely(!iavf_page_is_reusable(rx_buffer->page)))
+		return false;
+
+	/* keep a reference to tell when the stack has let go of the page */
+	if (!rx_buffer->pagecnt_bias) {
+		get_page(rx_buffer->page);
+		rx_buffer->pagecnt_bias = 1;
+	}
+
+	cache->bufs[cache->tail++ & cache->mask] = *rx_buffer;
+
+	return true;
+}
+
 /**
  * iavf_put_rx_buffer - Clean up used buffer and either recycle or free
  * @rx_ring: rx descriptor ring to transact packets on
@@ -1624,11 +2550,24 @@ static void iavf_put_rx_buffer(struct iavf_ring *rx_ring,
 	if (!rx_buffer)
 		return;
 
+#ifdef HAVE_PAGE_POOL
+	if (rx_ring->page_pool) {
+		/* a page nobody took a reference to goes straight back to
+		 * the pool, the ring gets a fresh one on refill
+		 */
+		if (rx_buffer->pagecnt_bias)
+			page_pool_recycle_direct(rx_ring->page_pool,
+						 rx_buffer->page);
+		rx_buffer->page = NULL;
+		return;
+	}
+
+#endif /* HAVE_PAGE_POOL */
 	if (iavf_can_reuse_rx_page(rx_buffer)) {
 		/* hand second half of page back to the ring */
 		iavf_reuse_rx_page(rx_ring, rx_buffer);
 		rx_ring->rx_stats.page_reuse_count++;
-	} else {
+	} else if (!iavf_rx_page_cache_put(rx_ring, rx_buffer)) {
 		/* we are not reusing the buffer so unmap it */
 		dma_unmap_page_attrs(rx_ring->dev, rx_buffer->dma,
 				     iavf_rx_pg_size(rx_ring),
@@ -1637,57 +2576,264 @@ static void iavf_put_rx_buffer(struct iavf_ring *rx_ring,
 					rx_buffer->pagecnt_bias);
 	}
 
-	/* clear contents of buffer_info */
-	rx_buffer->page = NULL;
+	/* clear contents of buffer_info */
+	rx_buffer->page = NULL;
+}
+
+/**
+ * iavf_is_non_eop - process handling of non-EOP buffers
+ * @rx_ring: Rx ring being processed
+ * @rx_desc: Rx descriptor for current buffer
+ * @skb: Current socket buffer containing buffer in progress
+ *
+ * This function updates next to clean.  If the buffer is an EOP buffer
+ * this function exits returning false, otherwise it will place the
+ * sk_buff in the next buffer to be chained and return true indicating
+ * that this is in fact a non-EOP buffer.
+ **/
+static bool iavf_is_non_eop(struct iavf_ring *rx_ring,
+			    union iavf_rx_desc *rx_desc,
+			    struct sk_buff *skb)
+{
+	u32 ntc = rx_ring->next_to_clean + 1;
+
+	/* fetch, update, and store next to clean */
+	ntc = (ntc < rx_ring->count) ? ntc : 0;
+	rx_ring->next_to_clean = ntc;
+
+	prefetch(IAVF_RX_DESC(rx_ring, ntc));
+
+	/* if we are the last buffer then there is nothing else to do */
+#define IAVF_RXD_EOF BIT(IAVF_RX_DESC_STATUS_EOF_SHIFT)
+	if (likely(iavf_test_staterr(rx_desc, IAVF_RXD_EOF)))
+		return false;
+
+	rx_ring->rx_stats.non_eop_descs++;
+
+	return true;
+}
+
+#ifdef HAVE_XDP_SUPPORT
+/**
+ * iavf_xmit_xdp_ring - transmit an XDP buffer on an XDP Tx ring
+ * @xdpf: data to transmit
+ * @xdp_ring: XDP Tx ring
+ *
+ * Places a single descriptor on the ring, the caller is responsible for
+ * bumping the tail once it's done queueing frames.
+ **/
+#ifdef HAVE_XDP_FRAME_STRUCT
+static int iavf_xmit_xdp_ring(struct xdp_frame *xdpf,
+			      struct iavf_ring *xdp_ring)
+#else
+static int iavf_xmit_xdp_ring(struct xdp_buff *xdpf,
+			      struct iavf_ring *xdp_ring)
+#endif
+{
+	u16 i = xdp_ring->next_to_use;
+	struct iavf_tx_buffer *tx_bi;
+	struct iavf_tx_desc *tx_desc;
+	void *data = xdpf->data;
+	dma_addr_t dma;
+	u32 size;
+
+#ifdef HAVE_XDP_FRAME_STRUCT
+	size = xdpf->len;
+#else
+	size = (u8 *)xdpf->data_end - (u8 *)xdpf->data;
+#endif
+	if (!unlikely(IAVF_DESC_UNUSED(xdp_ring))) {
+		xdp_ring->tx_stats.tx_busy++;
+		return IAVF_XDP_CONSUMED;
+	}
+
+	dma = dma_map_single(xdp_ring->dev, data, size, DMA_TO_DEVICE);
+	if (dma_mapping_error(xdp_ring->dev, dma))
+		return IAVF_XDP_CONSUMED;
+
+	tx_bi = &xdp_ring->tx_bi[i];
+	tx_bi->bytecount = size;
+	tx_bi->gso_segs = 1;
+#ifdef HAVE_XDP_FRAME_STRUCT
+	tx_bi->xdpf = xdpf;
+#else
+	tx_bi->raw_buf = data;
+#endif
+
+	/* record length, and DMA address */
+	dma_unmap_len_set(tx_bi, len, size);
+	dma_unmap_addr_set(tx_bi, dma, dma);
+
+	tx_desc = IAVF_TX_DESC(xdp_ring, i);
+	tx_desc->buffer_addr = cpu_to_le64(dma);
+	tx_desc->cmd_type_offset_bsz = build_ctob(IAVF_TX_DESC_CMD_ICRC |
+						  IAVF_TXD_CMD, 0, size, 0);
+
+	/* Make certain all of the status bits have been updated
+	 * before next_to_watch is written.
+	 */
+	smp_wmb();
+
+	i++;
+	if (i == xdp_ring->count)
+		i = 0;
+
+	tx_bi->next_to_watch = tx_desc;
+	xdp_ring->next_to_use = i;
+
+	return IAVF_XDP_TX;
+}
+
+/**
+ * iavf_xmit_xdp_tx_ring - transmit an XDP_TX verdict on the XDP Tx ring
+ * @xdp: XDP buffer holding the frame to send
+ * @xdp_ring: XDP Tx ring
+ **/
+int iavf_xmit_xdp_tx_ring(struct xdp_buff *xdp, struct iavf_ring *xdp_ring)
+{
+#ifdef HAVE_XDP_FRAME_STRUCT
+	struct xdp_frame *xdpf = xdp_convert_buff_to_frame(xdp);
+
+	/* not enough headroom in front of the frame to hold the xdp_frame */
+	if (unlikely(!xdpf))
+		return IAVF_XDP_CONSUMED;
+
+	return iavf_xmit_xdp_ring(xdpf, xdp_ring);
+#else
+	return iavf_xmit_xdp_ring(xdp, xdp_ring);
+#endif
 }
 
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
 /**
- * iavf_is_non_eop - process handling of non-EOP buffers
- * @rx_ring: Rx ring being processed
- * @rx_desc: Rx descriptor for current buffer
- * @skb: Current socket buffer containing buffer in progress
+ * iavf_xmit_xdp_tx_ring_zc - transmit an XDP_TX verdict of a zero-copy ring
+ * @xdp: XDP buffer holding the frame, a chunk of the AF_XDP pool
+ * @xdp_ring: XDP Tx ring
  *
- * This function updates next to clean.  If the buffer is an EOP buffer
- * this function exits returning false, otherwise it will place the
- * sk_buff in the next buffer to be chained and return true indicating
- * that this is in fact a non-EOP buffer.
+ * The frame is copied out of the chunk, and the chunk handed back, before
+ * the ring is tried.  A copy the ring has no room for is freed here so the
+ * caller doesn't recycle the chunk a second time.
+ *
+ * Returns IAVF_XDP_CONSUMED only if the chunk is still held
  **/
-static bool iavf_is_non_eop(struct iavf_ring *rx_ring,
-			    union iavf_rx_desc *rx_desc,
-			    struct sk_buff *skb)
+int iavf_xmit_xdp_tx_ring_zc(struct xdp_buff *xdp, struct iavf_ring *xdp_ring)
 {
-	u32 ntc = rx_ring->next_to_clean + 1;
-
-	/* fetch, update, and store next to clean */
-	ntc = (ntc < rx_ring->count) ? ntc : 0;
-	rx_ring->next_to_clean = ntc;
-
-	prefetch(IAVF_RX_DESC(rx_ring, ntc));
+	struct xdp_frame *xdpf = xdp_convert_buff_to_frame(xdp);
 
-	/* if we are the last buffer then there is nothing else to do */
-#define IAVF_RXD_EOF BIT(IAVF_RX_DESC_STATUS_EOF_SHIFT)
-	if (likely(iavf_test_staterr(rx_desc, IAVF_RXD_EOF)))
-		return false;
+	if (unlikely(!xdpf))
+		return IAVF_XDP_CONSUMED;
 
-	rx_ring->rx_stats.non_eop_descs++;
+	if (iavf_xmit_xdp_ring(xdpf, xdp_ring) != IAVF_XDP_TX)
+		xdp_return_frame(xdpf);
 
-	return true;
+	return IAVF_XDP_TX;
 }
 
-#define IAVF_XDP_PASS          0
-#define IAVF_XDP_CONSUMED      BIT(0)
-#define IAVF_XDP_TX            BIT(1)
-#define IAVF_XDP_REDIR         BIT(2)
-
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+#ifdef HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS
+/**
+ * iavf_xdp_xmit - implements ndo_xdp_xmit
+ * @dev: netdev the frames were redirected to
+ * @n: number of frames
+ * @frames: frames to transmit
+ * @flags: XDP_XMIT_FLUSH to bump the tail once the frames are queued
+ *
+ * The frames are queued on the ndo_xdp_xmit ring of the current CPU, and
+ * the tail is written once for the whole batch.  Rings are only shared, and
+ * locked, when the PF didn't give us one per CPU.
+ *
+ * Returns the number of frames queued or a negative error code.
+ **/
+int iavf_xdp_xmit(struct net_device *dev, int n, struct xdp_frame **frames,
+		  u32 flags)
+{
+	struct iavf_adapter *adapter = netdev_priv(dev);
+	struct iavf_vsi *vsi = &adapter->vsi;
+	int num_rings = READ_ONCE(adapter->num_xdp_xmit_queues);
+	struct iavf_ring *xdp_ring;
+	int nxmit = 0, i;
+	bool shared;
+	if (test_bit(__IAVF_VSI_DOWN, vsi->state))
+		return -ENETDOWN;
+	if (!num_rings || !vsi->xdp_xmit_rings)
+		return -ENXIO;
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+	xdp_ring = vsi->xdp_xmit_rings[smp_processor_id() % num_rings];
+	shared = !!(xdp_ring->flags & IAVF_TXR_FLAGS_XDP_SHARED);
+	if (shared)
+		spin_lock(&xdp_ring->tx_lock);
+	for (i = 0; i < n; i++) {
+		if (iavf_xmit_xdp_ring(frames[i], xdp_ring) != IAVF_XDP_TX) {
+#ifdef HAVE_XDP_XMIT_CORE_DROP
+			/* the caller frees whatever wasn't queued */
+			break;
+#else
+			xdp_return_frame(frames[i]);
+			continue;
+#endif /* HAVE_XDP_XMIT_CORE_DROP */
+		}
+		nxmit++;
+	}
+	if (flags & XDP_XMIT_FLUSH)
+		iavf_xdp_ring_update_tail(xdp_ring);
+	if (shared)
+		spin_unlock(&xdp_ring->tx_lock);
+	return nxmit;
+}
+#endif /* HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS */
+#endif /* HAVE_XDP_SUPPORT */
 /**
  * iavf_run_xdp - run an XDP program
  * @rx_ring: Rx ring being processed
  * @xdp: XDP buffer containing the frame
+ *
+ * Returns NULL when the frame should go up the stack, otherwise an error
+ * pointer holding the negated IAVF_XDP_* verdict.
  **/
 static struct sk_buff *iavf_run_xdp(struct iavf_ring *rx_ring,
 				    struct xdp_buff *xdp)
 {
 	int result = IAVF_XDP_PASS;
+#ifdef HAVE_XDP_SUPPORT
+	struct iavf_ring *xdp_ring;
+	struct bpf_prog *xdp_prog;
+	int err;
+	u32 act;
+
+	rcu_read_lock();
+	xdp_prog = READ_ONCE(rx_ring->xdp_prog);
+
+	if (!xdp_prog)
+		goto xdp_out;
+
+	prefetchw(xdp->data_hard_start); /* xdp_frame write */
+
+	act = bpf_prog_run_xdp(xdp_prog, xdp);
+	switch (act) {
+	case XDP_PASS:
+		break;
+	case XDP_TX:
+		xdp_ring = rx_ring->vsi->xdp_rings[rx_ring->queue_index];
+		result = iavf_xmit_xdp_tx_ring(xdp, xdp_ring);
+		break;
+	case XDP_REDIRECT:
+		err = xdp_do_redirect(rx_ring->netdev, xdp, xdp_prog);
+		result = !err ? IAVF_XDP_REDIR : IAVF_XDP_CONSUMED;
+		break;
+	default:
+		bpf_warn_invalid_xdp_action(rx_ring->netdev, xdp_prog, act);
+		/* fall through */
+	case XDP_ABORTED:
+		trace_xdp_exception(rx_ring->netdev, xdp_prog, act);
+		/* fall through -- handle aborts by dropping packet */
+	case XDP_DROP:
+		result = IAVF_XDP_CONSUMED;
+		break;
+	}
+xdp_out:
+	rcu_read_unlock();
+#endif /* HAVE_XDP_SUPPORT */
 	return (struct sk_buff *)ERR_PTR(-result);
 }
 
@@ -1702,7 +2848,7 @@ static void iavf_rx_buffer_flip(struct iavf_ring *rx_ring,
 				unsigned int size)
 {
 #if (PAGE_SIZE < 8192)
-	unsigned int truesize = iavf_rx_pg_size(rx_ring) / 2;
+	unsigned int truesize = iavf_rx_buf_truesize(rx_ring);
 
 	if (!rx_buffer)
 		return;
@@ -1716,15 +2862,31 @@ static void iavf_rx_buffer_flip(struct iavf_ring *rx_ring,
 #endif
 }
 
-static inline void iavf_xdp_ring_update_tail(struct iavf_ring *xdp_ring)
+#ifdef HAVE_XDP_BUFF_FRAME_SZ
+/**
+ * iavf_rx_frame_truesize - Returns the actual size of a received frame
+ * @rx_ring: Rx ring
+ * @size: Packet length from rx_desc
+ **/
+static unsigned int iavf_rx_frame_truesize(struct iavf_ring *rx_ring,
+					   unsigned int size)
 {
-	/* Force memory writes to complete before letting h/w
-	 * know there are new descriptors to fetch.
-	 */
-	wmb();
-	writel_relaxed(xdp_ring->next_to_use, xdp_ring->tail);
+	unsigned int truesize;
+
+#if (PAGE_SIZE < 8192)
+	truesize = iavf_rx_buf_truesize(rx_ring); /* Must be power-of-2 */
+#else
+	if (iavf_rx_uses_page_pool(rx_ring))
+		return iavf_rx_pg_size(rx_ring);
+	truesize = iavf_rx_offset(rx_ring) ?
+		SKB_DATA_ALIGN(iavf_rx_offset(rx_ring) + size) +
+		SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) :
+		SKB_DATA_ALIGN(size);
+#endif
+	return truesize;
 }
 
+#endif /* HAVE_XDP_BUFF_FRAME_SZ */
 /**
  * iavf_is_ctrl_pkt - check if packet is a TCP control packet or data packet
  * @skb: receive buffer
@@ -1843,24 +3005,119 @@ static void iavf_chnl_rx_stats(struct iavf_ring *rx_ring, u64 pkts)
 	}
 }
 
+#define IAVF_RXD_DD BIT(IAVF_RX_DESC_STATUS_DD_SHIFT)
+/**
+ * iavf_rx_scan_descs - Check a run of Rx descriptors for completion
+ * @rx_ring: rx descriptor ring to transact packets on
+ * @meta: array the completed descriptors are decoded into
+ * @max: maximum number of descriptors to check
+ * @desc_16b: ring uses 16-byte descriptors
+ *
+ * Reads the status qword of up to @max descriptors starting at
+ * next_to_clean and stops at the first one not yet written back.  A single
+ * read barrier then covers the whole run before the length, packet type and
+ * VLAN tag of each descriptor are decoded into @meta.
+ *
+ * Returns the number of completed descriptors
+ **/
+static __always_inline unsigned int
+iavf_rx_scan_descs(struct iavf_ring *rx_ring, struct iavf_rx_desc_meta *meta,
+		   unsigned int max, const bool desc_16b)
+{
+	union iavf_rx_desc *rx_desc;
+	unsigned int i, n;
+	u64 qword;
+	u16 ntc;
+
+	ntc = rx_ring->next_to_clean;
+	for (n = 0; n < max; n++) {
+		rx_desc = desc_16b ? IAVF_RX_DESC_16B(rx_ring, ntc) :
+				     IAVF_RX_DESC_32B(rx_ring, ntc);
+
+		/* status_error_len will always be zero for unused descriptors
+		 * because it's cleared in cleanup, and overlaps with hdr_addr
+		 * which is either zero because packet split isn't used or a
+		 * header buffer address with the DD bit clear, if the hardware
+		 * wrote DD then the length will be non-zero
+		 */
+		qword = le64_to_cpu(rx_desc->wb.qword1.status_error_len);
+		if (!(qword & IAVF_RXD_DD))
+			break;
+
+		meta[n].qword = qword;
+
+		if (unlikely(++ntc == rx_ring->count))
+			ntc = 0;
+	}
+
+	if (!n)
+		return 0;
+
+	/* This memory barrier is needed to keep us from reading
+	 * any other fields out of the rx_desc until we have
+	 * verified the descriptor has been written back.
+	 */
+	dma_rmb();
+
+	ntc = rx_ring->next_to_clean;
+	for (i = 0; i < n; i++) {
+		qword = meta[i].qword;
+		rx_desc = desc_16b ? IAVF_RX_DESC_16B(rx_ring, ntc) :
+				     IAVF_RX_DESC_32B(rx_ring, ntc);
+
+		meta[i].size = (qword & IAVF_RXD_QW1_LENGTH_PBUF_MASK) >>
+			       IAVF_RXD_QW1_LENGTH_PBUF_SHIFT;
+		meta[i].ptype = (qword & IAVF_RXD_QW1_PTYPE_MASK) >>
+				IAVF_RXD_QW1_PTYPE_SHIFT;
+		meta[i].vlan_tag =
+			(qword & BIT(IAVF_RX_DESC_STATUS_L2TAG1P_SHIFT)) ?
+			le16_to_cpu(rx_desc->wb.qword0.lo_dword.l2tag1) : 0;
+
+		if (unlikely(++ntc == rx_ring->count))
+			ntc = 0;
+	}
+
+	return n;
+}
+
 /**
- * iavf_clean_rx_irq - Clean completed descriptors from Rx ring - bounce buf
+ * __iavf_clean_rx_irq - Clean completed descriptors from Rx ring - bounce buf
  * @rx_ring: rx descriptor ring to transact packets on
  * @budget: Total limit on number of packets to process
+ * @desc_16b: ring uses 16-byte descriptors
  *
  * This function provides a "bounce buffer" approach to Rx interrupt
  * processing.  The advantage to this is that on systems that have
  * expensive overhead for IOMMU access this provides a means of avoiding
  * it by maintaining the mapping of the page to the system.
  *
+ * It is always inlined with a constant @desc_16b, so each descriptor size
+ * gets its own loop without a per-descriptor check of the ring layout.
+ *
+ * Where the stack takes lists of packets, the completed skbs are only
+ * collected while the descriptors are processed and go up the stack
+ * afterwards, as one list when GRO is off, so descriptor processing and
+ * the stack don't keep evicting each other from the instruction cache.
+ *
+ * Descriptors are checked for completion a run at a time by
+ * iavf_rx_scan_descs() rather than one barrier per descriptor.
+ *
  * Returns amount of work completed
  **/
-static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
+static __always_inline int __iavf_clean_rx_irq(struct iavf_ring *rx_ring,
+					       int budget, const bool desc_16b)
 {
 	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
+	struct iavf_rx_desc_meta meta[IAVF_RX_SCAN_BATCH];
+	unsigned int meta_idx = 0, meta_cnt = 0;
 	struct sk_buff *skb = rx_ring->skb;
 	u16 cleaned_count = IAVF_DESC_UNUSED(rx_ring);
 	unsigned int xdp_xmit = 0;
+#ifdef HAVE_NETIF_RECEIVE_SKB_LIST
+	unsigned int rx_list_len = 0;
+	bool rx_listed = false;
+	LIST_HEAD(rx_list);
+#endif /* HAVE_NETIF_RECEIVE_SKB_LIST */
 	bool failure = false;
 	struct xdp_buff xdp;
 
@@ -1869,52 +3126,69 @@ static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
 #endif
 
 	while (likely(total_rx_packets < (unsigned int)budget)) {
+		struct iavf_rx_desc_meta *rx_meta;
 		struct iavf_rx_buffer *rx_buffer;
 		union iavf_rx_desc *rx_desc;
-		unsigned int size;
-		u16 vlan_tag;
-		u8 rx_ptype;
+		unsigned int size, hlen;
 		u64 qword;
 
 		/* return some buffers to hardware, one at a time is too slow */
-		if (cleaned_count >= IAVF_RX_BUFFER_WRITE) {
+		if (cleaned_count >= rx_ring->rx_refill_thresh) {
 			failure = failure ||
 				  iavf_alloc_rx_buffers(rx_ring, cleaned_count);
 			cleaned_count = 0;
 		}
 
-		rx_desc = IAVF_RX_DESC(rx_ring, rx_ring->next_to_clean);
-
-		/* status_error_len will always be zero for unused descriptors
-		 * because it's cleared in cleanup, and overlaps with hdr_addr
-		 * which is always zero because packet split isn't used, if the
-		 * hardware wrote DD then the length will be non-zero
+		/* descriptors ahead of next_to_clean are never touched by
+		 * the refill above, so a run checked earlier stays valid
 		 */
-		qword = le64_to_cpu(rx_desc->wb.qword1.status_error_len);
+		if (meta_idx == meta_cnt) {
+			meta_cnt = iavf_rx_scan_descs(rx_ring, meta,
+						      IAVF_RX_SCAN_BATCH,
+						      desc_16b);
+			meta_idx = 0;
+			if (!meta_cnt)
+				break;
+		}
+		rx_meta = &meta[meta_idx++];
 
-		/* This memory barrier is needed to keep us from reading
-		 * any other fields out of the rx_desc until we have
-		 * verified the descriptor has been written back.
-		 */
-		dma_rmb();
-#define IAVF_RXD_DD BIT(IAVF_RX_DESC_STATUS_DD_SHIFT)
-		if (!iavf_test_staterr(rx_desc, IAVF_RXD_DD))
-			break;
+		if (desc_16b)
+			rx_desc = IAVF_RX_DESC_16B(rx_ring,
+						   rx_ring->next_to_clean);
+		else
+			rx_desc = IAVF_RX_DESC_32B(rx_ring,
+						   rx_ring->next_to_clean);
 
-		size = (qword & IAVF_RXD_QW1_LENGTH_PBUF_MASK) >>
-		       IAVF_RXD_QW1_LENGTH_PBUF_SHIFT;
+		qword = rx_meta->qword;
+		size = rx_meta->size;
+
+		/* the header of a split packet is in the header buffer and
+		 * the packet buffer holds only the payload, if any
+		 */
+		hlen = 0;
+		if (ring_uses_hdr_split(rx_ring) &&
+		    (qword & IAVF_RXD_QW1_LENGTH_SPH_MASK))
+			hlen = (qword & IAVF_RXD_QW1_LENGTH_HBUF_MASK) >>
+			       IAVF_RXD_QW1_LENGTH_HBUF_SHIFT;
 
 		iavf_trace(clean_rx_irq, rx_ring, rx_desc, skb);
 		rx_buffer = iavf_get_rx_buffer(rx_ring, size);
 
 		/* retrieve a buffer from the ring */
-		if (!skb) {
+		if (!skb && !hlen) {
 			if (rx_buffer) {
 				xdp.data = page_address(rx_buffer->page) +
 					   rx_buffer->page_offset;
 				xdp.data_hard_start = (void *)((u8 *)xdp.data -
 						      iavf_rx_offset(rx_ring));
 				xdp.data_end = (void *)((u8 *)xdp.data + size);
+#ifdef HAVE_XDP_BUFF_DATA_META
+				xdp_set_data_meta_invalid(&xdp);
+#endif
+#ifdef HAVE_XDP_BUFF_FRAME_SZ
+				xdp.frame_sz = iavf_rx_frame_truesize(rx_ring,
+								      size);
+#endif
 				skb = iavf_run_xdp(rx_ring, &xdp);
 			} else {
 				break;
@@ -1935,6 +3209,12 @@ static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
 			total_rx_packets++;
 		} else if (skb) {
 			iavf_add_rx_frag(rx_ring, rx_buffer, skb, size);
+		} else if (hlen) {
+			skb = iavf_construct_skb_hdr_split(rx_ring, rx_buffer,
+							   hlen, size);
+		} else if (size < READ_ONCE(rx_ring->rx_copybreak) &&
+			   iavf_test_staterr(rx_desc, IAVF_RXD_EOF)) {
+			skb = iavf_copybreak_skb(rx_ring, rx_buffer, &xdp);
 #ifdef HAVE_SWIOTLB_SKIP_CPU_SYNC
 		} else if (ring_uses_build_skb(rx_ring)) {
 			skb = iavf_build_skb(rx_ring, rx_buffer, &xdp);
@@ -1965,15 +3245,9 @@ static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
 		/* probably a little skewed due to removing CRC */
 		total_rx_bytes += skb->len;
 
-		qword = le64_to_cpu(rx_desc->wb.qword1.status_error_len);
-		rx_ptype = (qword & IAVF_RXD_QW1_PTYPE_MASK) >>
-			   IAVF_RXD_QW1_PTYPE_SHIFT;
-
 		/* populate checksum, VLAN, and protocol */
-		iavf_process_skb_fields(rx_ring, rx_desc, skb, rx_ptype);
+		iavf_process_skb_fields(rx_ring, rx_desc, skb, rx_meta->ptype);
 
-		vlan_tag = (qword & BIT(IAVF_RX_DESC_STATUS_L2TAG1P_SHIFT)) ?
-			   le16_to_cpu(rx_desc->wb.qword0.lo_dword.l2tag1) : 0;
 		if (vector_ch_ena(rx_ring->q_vector) &&
 		    vector_ch_perf_ena(rx_ring->q_vector)) {
 			if (!iavf_is_ctrl_pkt(skb, rx_ring))
@@ -1982,13 +3256,24 @@ static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
 		}
 
 		iavf_trace(clean_rx_irq_rx, rx_ring, rx_desc, skb);
-		iavf_receive_skb(rx_ring, skb, vlan_tag);
+#ifdef HAVE_NETIF_RECEIVE_SKB_LIST
+		iavf_rx_vlan(rx_ring, skb, rx_meta->vlan_tag);
+		list_add_tail(&skb->list, &rx_list);
+		rx_list_len++;
+#else
+		iavf_receive_skb(rx_ring, skb, rx_meta->vlan_tag);
+#endif /* HAVE_NETIF_RECEIVE_SKB_LIST */
 		skb = NULL;
 
 		/* update budget accounting */
 		total_rx_packets++;
 	}
 
+#ifdef HAVE_NETIF_RECEIVE_SKB_LIST
+	if (rx_list_len)
+		rx_listed = iavf_receive_skb_list(rx_ring, &rx_list);
+
+#endif /* HAVE_NETIF_RECEIVE_SKB_LIST */
 	if (xdp_xmit & IAVF_XDP_REDIR)
 		xdp_do_flush_map();
 
@@ -2003,15 +3288,47 @@ static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
 	u64_stats_update_begin(&rx_ring->syncp);
 	rx_ring->stats.packets += total_rx_packets;
 	rx_ring->stats.bytes += total_rx_bytes;
+#ifdef HAVE_NETIF_RECEIVE_SKB_LIST
+	if (rx_listed) {
+		rx_ring->rx_stats.nogro_list_batches++;
+		rx_ring->rx_stats.nogro_list_pkts += rx_list_len;
+	}
+#endif /* HAVE_NETIF_RECEIVE_SKB_LIST */
 	u64_stats_update_end(&rx_ring->syncp);
 	iavf_chnl_rx_stats(rx_ring, total_rx_packets);
 	rx_ring->q_vector->rx.total_packets += total_rx_packets;
 	rx_ring->q_vector->rx.total_bytes += total_rx_bytes;
 
+	iavf_update_rx_refill_thresh(rx_ring, total_rx_packets, budget);
+
 	/* guarantee a trip back through this routine if there was a failure */
 	return failure ? budget : (int)total_rx_packets;
 }
 
+/**
+ * iavf_clean_rx_irq - Clean completed 32-byte descriptors from Rx ring
+ * @rx_ring: rx descriptor ring to transact packets on
+ * @budget: Total limit on number of packets to process
+ *
+ * Returns amount of work completed
+ **/
+static int iavf_clean_rx_irq(struct iavf_ring *rx_ring, int budget)
+{
+	return __iavf_clean_rx_irq(rx_ring, budget, false);
+}
+
+/**
+ * iavf_clean_rx_irq_16b - Clean completed 16-byte descriptors from Rx ring
+ * @rx_ring: rx descriptor ring to transact packets on
+ * @budget: Total limit on number of packets to process
+ *
+ * Returns amount of work completed
+ **/
+static int iavf_clean_rx_irq_16b(struct iavf_ring *rx_ring, int budget)
+{
+	return __iavf_clean_rx_irq(rx_ring, budget, true);
+}
+
 static inline u32 iavf_buildreg_itr(const int type, u16 itr)
 {
 	u32 val;
@@ -2075,8 +3392,19 @@ static inline void iavf_update_enable_itr(struct iavf_vsi *vsi,
 	}
 
 	/* These will do nothing if dynamic updates are not enabled */
+#ifdef HAVE_DIM
+	if (iavf_dim_profile(q_vector->adapter) >= 0) {
+		q_vector->total_events++;
+		iavf_net_dim(q_vector, &q_vector->tx);
+		iavf_net_dim(q_vector, &q_vector->rx);
+	} else {
+		iavf_update_itr(q_vector, &q_vector->tx);
+		iavf_update_itr(q_vector, &q_vector->rx);
+	}
+#else
 	iavf_update_itr(q_vector, &q_vector->tx);
 	iavf_update_itr(q_vector, &q_vector->rx);
+#endif /* HAVE_DIM */
 
 	/* This block of logic allows us to get away with only updating
 	 * one ITR value with each interrupt. The idea is to perform a
@@ -2092,6 +3420,7 @@ static inline void iavf_update_enable_itr(struct iavf_vsi *vsi,
 					   q_vector->rx.target_itr);
 		q_vector->rx.current_itr = q_vector->rx.target_itr;
 		q_vector->itr_countdown = ITR_COUNTDOWN_START;
+		q_vector->itr_stats.rx_itr_updates++;
 	} else if ((q_vector->tx.target_itr < q_vector->tx.current_itr) ||
 		   ((q_vector->rx.target_itr - q_vector->rx.current_itr) <
 		    (q_vector->tx.target_itr - q_vector->tx.current_itr))) {
@@ -2102,12 +3431,14 @@ static inline void iavf_update_enable_itr(struct iavf_vsi *vsi,
 					   q_vector->tx.target_itr);
 		q_vector->tx.current_itr = q_vector->tx.target_itr;
 		q_vector->itr_countdown = ITR_COUNTDOWN_START;
+		q_vector->itr_stats.tx_itr_updates++;
 	} else if (q_vector->rx.current_itr != q_vector->rx.target_itr) {
 		/* Rx ITR needs to be increased, third priority */
 		intval = iavf_buildreg_itr(IAVF_RX_ITR,
 					   q_vector->rx.target_itr);
 		q_vector->rx.current_itr = q_vector->rx.target_itr;
 		q_vector->itr_countdown = ITR_COUNTDOWN_START;
+		q_vector->itr_stats.rx_itr_updates++;
 	} else {
 		/* No ITR update, lowest priority */
 		intval = iavf_buildreg_itr(IAVF_ITR_NONE, 0);
@@ -2119,6 +3450,19 @@ do_write:
 		wr32(hw, INTREG(q_vector->reg_idx), intval);
 }
 
+/**
+ * iavf_napi_threaded - check if a NAPI instance is polled by its kthread
+ * @napi: ptr to NAPI struct
+ **/
+static bool iavf_napi_threaded(struct napi_struct *napi)
+{
+#ifdef HAVE_NAPI_THREADED
+	return test_bit(NAPI_STATE_THREADED, &napi->state);
+#else
+	return false;
+#endif /* HAVE_NAPI_THREADED */
+}
+
 /**
  * iavf_refresh_bp_state - refresh state machine
  * @napi: ptr to NAPI struct
@@ -2166,7 +3510,12 @@ static void iavf_refresh_bp_state(struct napi_struct *napi)
 		else
 			q_vector->ch_stats.bp_to_bp++;
 	} else {
+		/* polls run by the NAPI kthread are still interrupt driven,
+		 * the interrupt only wakes the thread instead of the softirq
+		 */
 		q_vector->ch_stats.in_intr++;
+		if (iavf_napi_threaded(napi))
+			q_vector->ch_stats.in_threaded++;
 		/* state transition : BUSY_POLL --> INTERRUPT */
 		if (q_vector->state_flags & IAVF_VECTOR_STATE_PREV_IN_BP)
 			q_vector->ch_stats.bp_to_intr++;
@@ -2231,6 +3580,83 @@ iavf_handle_chnl_vector(struct iavf_vsi *vsi, struct iavf_q_vector *q_vector,
 	}
 }
 
+/**
+ * iavf_poll_rx_ring - clean an Rx ring with the routine matching its setup
+ * @rx_ring: ring to clean
+ * @budget: most packets to clean
+ *
+ * Returns the number of packets cleaned
+ **/
+static int iavf_poll_rx_ring(struct iavf_ring *rx_ring, int budget)
+{
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	if (rx_ring->xsk_pool)
+		return iavf_clean_rx_irq_zc(rx_ring, budget);
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+	if (ring_uses_16byte_desc(rx_ring))
+		return iavf_clean_rx_irq_16b(rx_ring, budget);
+
+	return iavf_clean_rx_irq(rx_ring, budget);
+}
+
+/**
+ * iavf_clean_rx_rings_drr - share the NAPI budget among a vector's Rx rings
+ * @q_vector: vector being polled
+ * @budget: NAPI budget
+ * @clean_complete: cleared when a ring is left with work pending
+ *
+ * Deficit round robin: each round, every ring that still has work is
+ * credited a quantum of budget / rings and cleans up to its credit.  A ring
+ * that runs dry drops out of the poll and forgets its credit, so the budget
+ * it didn't use goes to the busy rings in the following rounds.  A ring cut
+ * short when the budget runs out keeps what it was owed for the next poll,
+ * which starts with the ring after the last one served.
+ *
+ * Returns the number of packets cleaned, never more than @budget
+ **/
+static int iavf_clean_rx_rings_drr(struct iavf_q_vector *q_vector, int budget,
+				   bool *clean_complete)
+{
+	int quantum = max(budget / q_vector->rx.count, 1);
+	int remaining = budget, busy = 0;
+	struct iavf_ring *ring;
+
+	iavf_for_each_ring(ring, q_vector->rx) {
+		ring->flags &= ~IAVF_RXR_FLAGS_DRR_IDLE;
+		busy++;
+	}
+
+	ring = q_vector->rx_drr_next ? : q_vector->rx.ring;
+	while (remaining && busy) {
+		if (!(ring->flags & IAVF_RXR_FLAGS_DRR_IDLE)) {
+			int credit = min(ring->rx_deficit + quantum, budget);
+			int share = min(credit, remaining);
+			int cleaned = iavf_poll_rx_ring(ring, share);
+
+			remaining -= cleaned;
+			if (cleaned < share) {
+				ring->flags |= IAVF_RXR_FLAGS_DRR_IDLE;
+				ring->rx_deficit = 0;
+				busy--;
+			} else {
+				ring->rx_deficit = credit - cleaned;
+			}
+		}
+
+		ring = ring->next ? : q_vector->rx.ring;
+	}
+	q_vector->rx_drr_next = ring;
+
+	if (busy) {
+		*clean_complete = false;
+		iavf_for_each_ring(ring, q_vector->rx)
+			if (!(ring->flags & IAVF_RXR_FLAGS_DRR_IDLE))
+				ring->rx_stats.rx_starved++;
+	}
+
+	return budget - remaining;
+}
+
 /**
  * iavf_napi_poll - NAPI polling Rx/Tx cleanup routine
  * @napi: napi struct with our devices info in it
@@ -2253,7 +3679,6 @@ int iavf_napi_poll(struct napi_struct *napi, int budget)
 	bool wb_on_itr_enabled;
 	struct iavf_ring *ring;
 	bool arm_wb = false;
-	int budget_per_ring;
 	int work_done = 0;
 
 	if (test_bit(__IAVF_VSI_DOWN, vsi->state)) {
@@ -2314,7 +3739,16 @@ int iavf_napi_poll(struct napi_struct *napi, int budget)
 	 * budget and be more aggressive about cleaning up the Tx descriptors.
 	 */
 	iavf_for_each_ring(ring, q_vector->tx) {
-		if (!iavf_clean_tx_irq(vsi, ring, budget)) {
+		bool wd;
+
+		iavf_tx_db_flush(ring);
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+		wd = ring->xsk_pool ? iavf_clean_xdp_tx_irq(vsi, ring) :
+				      iavf_clean_tx_irq(vsi, ring, budget);
+#else
+		wd = iavf_clean_tx_irq(vsi, ring, budget);
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+		if (!wd) {
 			clean_complete = false;
 			continue;
 		}
@@ -2340,17 +3774,13 @@ int iavf_napi_poll(struct napi_struct *napi, int budget)
 	if (ch_enabled && vector_busypoll_intr(q_vector))
 		goto bypass;
 
-	/* We attempt to distribute budget to each Rx queue fairly, but don't
-	 * allow the budget to go below 1 because that would exit polling early.
-	 */
-	budget_per_ring = max(budget/q_vector->num_ringpairs, 1);
-
-	iavf_for_each_ring(ring, q_vector->rx) {
-		int cleaned = iavf_clean_rx_irq(ring, budget_per_ring);
-
-		work_done += cleaned;
+	if (q_vector->rx.count > 1) {
+		work_done = iavf_clean_rx_rings_drr(q_vector, budget,
+						    &clean_complete);
+	} else if (q_vector->rx.ring) {
+		work_done = iavf_poll_rx_ring(q_vector->rx.ring, budget);
 		/* if we clean as many as budgeted, we must not be done */
-		if (cleaned >= budget_per_ring)
+		if (work_done >= budget)
 			clean_complete = false;
 	}
 
@@ -2374,9 +3804,11 @@ int iavf_napi_poll(struct napi_struct *napi, int budget)
 		 * traffic continues and the interrupt will be stuck on this
 		 * cpu.  We check to make sure affinity is correct before we
 		 * continue to poll, otherwise we must stop polling so the
-		 * interrupt can move to the correct cpu.
+		 * interrupt can move to the correct cpu.  A NAPI kthread runs
+		 * wherever it was pinned, independent of the interrupt.
 		 */
-		if (!cpumask_test_cpu(cpu_id, &q_vector->affinity_mask)) {
+		if (!iavf_napi_threaded(napi) &&
+		    !cpumask_test_cpu(cpu_id, &q_vector->affinity_mask)) {
 			/* Tell napi that we are done polling */
 			napi_complete_done(napi, work_done);
 			q_vector->ch_stats.intr_en_not_clean_complete++;
@@ -2968,19 +4400,16 @@ int __iavf_maybe_stop_tx(struct iavf_ring *tx_ring, int size)
 }
 
 /**
- * __iavf_chk_linearize - Check if there are more than 8 buffers per packet
+ * iavf_tx_short_window - Find a fragment window a TSO segment can't fit in
  * @skb:      send buffer
  *
- * Note: Our HW can't DMA more than 8 buffers to build a packet on the wire
- * and so we need to figure out the cases where we need to linearize the skb.
+ * Walks the fragments the way __iavf_chk_linearize() describes.
  *
- * For TSO we need to count the TSO header and segment payload separately.
- * As such we need to check cases where we have 7 fragments or more as we
- * can potentially require 9 DMA transactions, 1 for the TSO header, 1 for
- * the segment payload in the first descriptor, and another 7 for the
- * fragments.
+ * Returns the index of the first of the IAVF_MAX_BUFFER_TXD - 2 fragments
+ * of the first window that totals less than gso_size, or -1 if there is
+ * none.
  **/
-bool __iavf_chk_linearize(struct sk_buff *skb)
+static int iavf_tx_short_window(struct sk_buff *skb)
 {
 	const skb_frag_t *frag, *stale;
 	int nr_frags, sum;
@@ -2988,7 +4417,7 @@ bool __iavf_chk_linearize(struct sk_buff *skb)
 	/* no need to check if number of frags is less than 7 */
 	nr_frags = skb_shinfo(skb)->nr_frags;
 	if (nr_frags < (IAVF_MAX_BUFFER_TXD - 1))
-		return false;
+		return -1;
 
 	/* We need to walk through the list and validate that each group
 	 * of 6 fragments totals at least gso_size.
@@ -3040,7 +4469,7 @@ bool __iavf_chk_linearize(struct sk_buff *skb)
 
 		/* if sum is negative we failed to make sufficient progress */
 		if (sum < 0)
-			return true;
+			return stale - skb_shinfo(skb)->frags;
 
 		if (!nr_frags--)
 			break;
@@ -3048,7 +4477,124 @@ bool __iavf_chk_linearize(struct sk_buff *skb)
 		sum -= stale_size;
 	}
 
-	return false;
+	return -1;
+}
+
+/**
+ * __iavf_chk_linearize - Check if there are more than 8 buffers per packet
+ * @skb:      send buffer
+ *
+ * Note: Our HW can't DMA more than 8 buffers to build a packet on the wire
+ * and so we need to figure out the cases where we need to linearize the skb.
+ *
+ * For TSO we need to count the TSO header and segment payload separately.
+ * As such we need to check cases where we have 7 fragments or more as we
+ * can potentially require 9 DMA transactions, 1 for the TSO header, 1 for
+ * the segment payload in the first descriptor, and another 7 for the
+ * fragments.
+ **/
+bool __iavf_chk_linearize(struct sk_buff *skb)
+{
+	return iavf_tx_short_window(skb) >= 0;
+}
+
+/**
+ * iavf_tx_merge_frags - Copy a run of fragments into a single new one
+ * @skb:      send buffer
+ * @first:    index of the first fragment to merge
+ * @nr:       number of fragments to merge
+ *
+ * Returns 0 on success, negative on failure; @skb is left as it was on
+ * failure.
+ **/
+static int iavf_tx_merge_frags(struct sk_buff *skb, int first, int nr)
+{
+	struct skb_shared_info *shinfo;
+	unsigned int offset, len = 0;
+	struct page *page;
+	int i;
+
+	/* the frag array may be shared with a clone, e.g. the one TCP keeps
+	 * for retransmits, so get our own before rewriting it
+	 */
+	if (skb_cloned(skb) && pskb_expand_head(skb, 0, 0, GFP_ATOMIC))
+		return -ENOMEM;
+
+	shinfo = skb_shinfo(skb);
+#ifdef HAVE_SKB_MARK_FOR_RECYCLE
+	/* page_pool frags can't simply be put */
+	if (skb->pp_recycle)
+		return -EINVAL;
+#endif /* HAVE_SKB_MARK_FOR_RECYCLE */
+
+	offset = skb_headlen(skb);
+	for (i = 0; i < first; i++)
+		offset += skb_frag_size(&shinfo->frags[i]);
+	for (i = first; i < first + nr; i++)
+		len += skb_frag_size(&shinfo->frags[i]);
+
+	page = alloc_pages(GFP_ATOMIC | __GFP_NOWARN | __GFP_COMP,
+			   get_order(len));
+	if (!page)
+		return -ENOMEM;
+
+	if (skb_copy_bits(skb, offset, page_address(page), len)) {
+		__free_pages(page, get_order(len));
+		return -EFAULT;
+	}
+
+	for (i = first; i < first + nr; i++)
+		put_page(skb_frag_page(&shinfo->frags[i]));
+
+	memmove(&shinfo->frags[first + 1], &shinfo->frags[first + nr],
+		(shinfo->nr_frags - first - nr) * sizeof(skb_frag_t));
+	shinfo->nr_frags -= nr - 1;
+	__skb_fill_page_desc(skb, first, page, 0, len);
+
+	return 0;
+}
+
+/**
+ * iavf_tx_coalesce - Fit a frame in the descriptor limit without linearizing
+ * @skb:      send buffer
+ * @count:    number of data descriptors the frame needs
+ *
+ * Rather than copying the whole frame, which for a 64K TSO frame means a
+ * 64K allocation, only the fragments that break the limit are copied: each
+ * window of fragments too short to carry a TSO segment, or the trailing
+ * fragments of a non-TSO frame, is merged into a single new fragment.
+ *
+ * Returns 0 if the frame now fits, negative if it still has to be
+ * linearized.
+ **/
+static int iavf_tx_coalesce(struct sk_buff *skb, int count)
+{
+	int first, nr, err;
+
+	if (!skb_is_gso(skb)) {
+		/* a frame this size takes one descriptor per fragment */
+		nr = count - IAVF_MAX_BUFFER_TXD + 1;
+		first = skb_shinfo(skb)->nr_frags - nr;
+		if (first < 0)
+			return -EINVAL;
+
+		err = iavf_tx_merge_frags(skb, first, nr);
+		if (err)
+			return err;
+
+		return iavf_xmit_descriptor_count(skb) > IAVF_MAX_BUFFER_TXD ?
+		       -EINVAL : 0;
+	}
+
+	/* each merge takes 5 fragments off, so this ends */
+	while ((first = iavf_tx_short_window(skb)) >= 0) {
+		err = iavf_tx_merge_frags(skb, first,
+					  IAVF_MAX_BUFFER_TXD - 2);
+		if (err)
+			return err;
+	}
+
+	return 0;
 }
 
 /**
@@ -3085,9 +4631,21 @@ static inline int iavf_tx_map(struct iavf_ring *tx_ring, struct sk_buff *skb,
 #endif
 	}
 
-	first->tx_flags = tx_flags;
+	/* copy a small linear part into the bounce slot of its descriptor,
+	 * which stays mapped for the life of the ring
+	 */
+	if (tx_ring->tx_bounce && size <= READ_ONCE(tx_ring->tx_copybreak)) {
+		skb_copy_from_linear_data(skb, tx_ring->tx_bounce +
+					  i * IAVF_TX_BOUNCE_SLOT, size);
+		dma = tx_ring->tx_bounce_dma + i * IAVF_TX_BOUNCE_SLOT;
+		tx_flags |= IAVF_TX_FLAGS_BOUNCE;
+		tx_ring->tx_stats.tx_bounce++;
+	} else {
+		dma = dma_map_single(tx_ring->dev, skb->data, size,
+				     DMA_TO_DEVICE);
+	}
 
-	dma = dma_map_single(tx_ring->dev, skb->data, size, DMA_TO_DEVICE);
+	first->tx_flags = tx_flags;
 
 	tx_desc = IAVF_TX_DESC(tx_ring, i);
 	tx_bi = first;
@@ -3098,8 +4656,12 @@ static inline int iavf_tx_map(struct iavf_ring *tx_ring, struct sk_buff *skb,
 		if (dma_mapping_error(tx_ring->dev, dma))
 			goto dma_error;
 
-		/* record length, and DMA address */
-		dma_unmap_len_set(tx_bi, len, size);
+		/* record length, and DMA address; a bounce slot is never
+		 * unmapped so it is recorded with a length of zero
+		 */
+		dma_unmap_len_set(tx_bi, len,
+				  ((tx_flags & IAVF_TX_FLAGS_BOUNCE) &&
+				   tx_bi == first) ? 0 : size);
 		dma_unmap_addr_set(tx_bi, dma, dma);
 
 		/* align size to end of page */
@@ -3165,9 +4727,11 @@ static inline int iavf_tx_map(struct iavf_ring *tx_ring, struct sk_buff *skb,
 			build_ctob(td_cmd, td_offset, size, td_tag);
 
 	/* timestamp the skb as late as possible, just prior to notifying
-	 * the MAC that it should transmit this packet
+	 * the MAC that it should transmit this packet, unless the stamp is
+	 * taken on completion
 	 */
-	skb_tx_timestamp(skb);
+	if (!(tx_flags & IAVF_TX_FLAGS_TSTAMP_COMPL))
+		skb_tx_timestamp(skb);
 
 	/* Force memory writes to complete before letting h/w know there
 	 * are new descriptors to fetch.
@@ -3182,8 +4746,13 @@ static inline int iavf_tx_map(struct iavf_ring *tx_ring, struct sk_buff *skb,
 
 	/* notify HW of packet */
 #ifdef HAVE_SKB_XMIT_MORE
-	if (netif_xmit_stopped(txring_txq(tx_ring)) || !netdev_xmit_more()) {
-		writel(i, tx_ring->tail);
+	/* a timestamped packet doesn't wait for the doorbell, that would
+	 * only add to the latency being measured
+	 */
+	if ((netif_xmit_stopped(txring_txq(tx_ring)) || !netdev_xmit_more()) &&
+	    ((tx_flags & IAVF_TX_FLAGS_TSTAMP_COMPL) ||
+	     !iavf_tx_db_defer(tx_ring))) {
+		iavf_tx_db_write(tx_ring, i);
 
 #ifndef SPIN_UNLOCK_IMPLIES_MMIOWB
 		/* We need this mmiowb on IA64/Altix systems where wmb() isn't
@@ -3198,7 +4767,9 @@ static inline int iavf_tx_map(struct iavf_ring *tx_ring, struct sk_buff *skb,
 #endif /* SPIN_UNLOCK_IMPLIES_MMIOWB */
 	}
 #else
-	writel(i, tx_ring->tail);
+	if ((tx_flags & IAVF_TX_FLAGS_TSTAMP_COMPL) ||
+	    !iavf_tx_db_defer(tx_ring))
+		iavf_tx_db_write(tx_ring, i);
 
 #ifndef SPIN_UNLOCK_IMPLIES_MMIOWB
 	/* We need this mmiowb on IA64/Altix systems where wmb() isn't
@@ -3263,12 +4834,18 @@ static netdev_tx_t iavf_xmit_frame_ring(struct sk_buff *skb,
 
 	count = iavf_xmit_descriptor_count(skb);
 	if (iavf_chk_linearize(skb, count)) {
-		if (__skb_linearize(skb)) {
-			dev_kfree_skb_any(skb);
-			return NETDEV_TX_OK;
+		/* copy only the fragments in the way, or else everything */
+		if (!iavf_tx_coalesce(skb, count)) {
+			count = iavf_xmit_descriptor_count(skb);
+			tx_ring->tx_stats.tx_coalesce++;
+		} else {
+			if (__skb_linearize(skb)) {
+				dev_kfree_skb_any(skb);
+				return NETDEV_TX_OK;
+			}
+			count = iavf_txd_use_count(skb->len);
+			tx_ring->tx_stats.tx_linearize++;
 		}
-		count = iavf_txd_use_count(skb->len);
-		tx_ring->tx_stats.tx_linearize++;
 	}
 
 	/* need: 1 descriptor per page * PAGE_SIZE/IAVF_MAX_DATA_PER_TXD,
@@ -3292,6 +4869,10 @@ static netdev_tx_t iavf_xmit_frame_ring(struct sk_buff *skb,
 	if (iavf_tx_prepare_vlan_flags(skb, tx_ring, &tx_flags))
 		goto out_drop;
 
+	if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_SW_TSTAMP) &&
+	    (tx_ring->vsi->back->flags & IAVF_FLAG_TX_TSTAMP_COMPL))
+		tx_flags |= IAVF_TX_FLAGS_TSTAMP_COMPL;
+
 	/* obtain protocol of skb */
 	protocol = vlan_get_protocol(skb);
 
@@ -262,6 +262,12 @@ static inline unsigned int iavf_txd_use_count(unsigned int size)
 #define DESC_NEEDED (MAX_SKB_FRAGS + 6)
 #define IAVF_MIN_DESC_PENDING	4
 
+/* With doorbell coalescing the tail is written once this many descriptors are
+ * pending, or IAVF_TX_DB_USECS after the first one was held back.
+ */
+#define IAVF_TX_DB_BATCH	32
+#define IAVF_TX_DB_USECS	10
+
 #define IAVF_TX_FLAGS_HW_VLAN		BIT(1)
 #define IAVF_TX_FLAGS_SW_VLAN		BIT(2)
 #define IAVF_TX_FLAGS_TSO		BIT(3)
@@ -271,6 +277,8 @@ static inline unsigned int iavf_txd_use_count(unsigned int size)
 #define IAVF_TX_FLAGS_FSO		BIT(7)
 #define IAVF_TX_FLAGS_FD_SB		BIT(9)
 #define IAVF_TX_FLAGS_TUNNEL		BIT(10)
+#define IAVF_TX_FLAGS_BOUNCE		BIT(11)	/* head copied, not mapped */
+#define IAVF_TX_FLAGS_TSTAMP_COMPL	BIT(12)	/* stamp on completion */
 #define IAVF_TX_FLAGS_VLAN_MASK		0xffff0000
 #define IAVF_TX_FLAGS_VLAN_PRIO_MASK	0xe0000000
 #define IAVF_TX_FLAGS_VLAN_PRIO_SHIFT	29
@@ -293,13 +301,43 @@ struct iavf_tx_buffer {
 
 struct iavf_rx_buffer {
 	dma_addr_t dma;
-	struct page *page;
+	union {
+		struct {
+			struct page *page;
 #if (BITS_PER_LONG > 32) || (PAGE_SIZE >= 65536)
-	__u32 page_offset;
+			__u32 page_offset;
 #else
-	__u16 page_offset;
+			__u16 page_offset;
 #endif
-	__u16 pagecnt_bias;
+			__u16 pagecnt_bias;
+		};
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+		struct xdp_buff *xdp;
+#else
+		struct {
+			void *addr;
+			u64 handle;
+		};
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+	};
+};
+
+/* FIFO of mapped Rx pages waiting for the stack to release them */
+struct iavf_rx_page_cache {
+	u32 head;			/* oldest entry, next to be reused */
+	u32 tail;			/* next free entry */
+	u32 mask;			/* entries - 1, entries is a power of 2 */
+	struct iavf_rx_buffer bufs[];
+};
+
+/* completed Rx descriptor, decoded ahead of building its skb */
+struct iavf_rx_desc_meta {
+	u64 qword;			/* status_error_len as written back */
+	u16 size;			/* packet buffer length */
+	u16 vlan_tag;			/* stripped tag, 0 if none */
+	u8 ptype;
 };
 
 struct iavf_queue_stats {
@@ -312,7 +350,18 @@ struct iavf_tx_queue_stats {
 	u64 tx_busy;
 	u64 tx_done_old;
 	u64 tx_linearize;
+	u64 tx_coalesce;	/* frames fixed by merging a few frags */
 	u64 tx_force_wb;
+	u64 tx_head_wb_off;	/* PF ignored the head writeback request */
+	u64 tx_bounce;		/* packets sent from a bounce buffer */
+	u64 tx_work_boost;	/* cleanups run past the work limit */
+	u64 tx_work_exhausted;	/* cleanups that ran out of budget */
+	u64 tx_doorbell;	/* Tx tail writes */
+	u64 tx_db_deferred;	/* tail writes held back for coalescing */
+	u64 tx_db_napi;		/* held back tail writes done by NAPI */
+	u64 tx_db_timer;	/* coalescing timer expiries */
+	u64 tx_tstamp;		/* software stamps taken on completion */
+	u64 prev_stops;		/* tx_busy + restart_queue at last cleanup */
 	int prev_pkt_ctr;
 };
 
@@ -322,6 +371,12 @@ struct iavf_rx_queue_stats {
 	u64 alloc_buff_failed;
 	u64 page_reuse_count;
 	u64 realloc_count;
+	u64 nogro_list_batches;	/* batches handed up as a list, GRO off */
+	u64 nogro_list_pkts;	/* packets handed up in those batches */
+	u64 copybreak_pkts;	/* packets copied out of their buffer */
+	u64 page_cache_hit;	/* buffers refilled from the page cache */
+	u64 page_cache_miss;	/* buffers that needed a new mapping */
+	u64 rx_starved;		/* polls that ended before the ring ran dry */
 };
 
 struct iavf_ch_tx_q_stats {
@@ -389,10 +444,16 @@ struct iavf_ring {
 	 * before programming to a register.
 	 */
 	u16 itr_setting;
+	u16 work_limit;			/* Tx packets cleaned per poll, before
+					 * iavf_tx_work_limit() raises it
+					 */
 
 	u16 count;			/* Number of descriptors */
 	u16 reg_idx;			/* HW register index of the ring */
 	u16 rx_buf_len;
+	u16 rx_copybreak;		/* copy frames shorter than this */
+	u16 tx_copybreak;		/* bounce linear parts up to this */
+	u16 rx_refill_thresh;		/* refill once this many are free */
 
 	/* used in interrupt processing */
 	u16 next_to_use;
@@ -409,6 +470,13 @@ struct iavf_ring {
 #define IAVF_TXR_FLAGS_WB_ON_ITR		BIT(0)
 #define IAVF_RXR_FLAGS_BUILD_SKB_ENABLED	BIT(1)
 #define IAVF_TXR_FLAGS_XDP			BIT(2)
+#define IAVF_RXR_FLAGS_HDR_SPLIT		BIT(3)
+#define IAVF_RXR_FLAGS_DESC_16B			BIT(4)
+#define IAVF_TXR_FLAGS_HEAD_WB			BIT(5)
+#define IAVF_TXR_FLAGS_HEAD_WB_SEEN		BIT(6)
+#define IAVF_TXR_FLAGS_XDP_SHARED		BIT(7)
+#define IAVF_TXR_FLAGS_DB_DEFER			BIT(8)
+#define IAVF_RXR_FLAGS_DRR_IDLE			BIT(9)
 
 	/* stats structs */
 	struct iavf_queue_stats	stats;
@@ -429,7 +497,13 @@ struct iavf_ring {
 	struct iavf_q_vector *q_vector;	/* Backreference to associated vector */
 
 	struct rcu_head rcu;		/* to avoid race on free */
+	spinlock_t tx_lock;		/* serializes CPUs sharing an
+					 * ndo_xdp_xmit ring
+					 */
+	struct hrtimer db_timer;	/* writes a held back tail */
+	u16 db_tail;			/* last value written to the tail */
 	u16 next_to_alloc;
+	u16 rx_deficit;			/* budget owed from the last poll */
 	struct sk_buff *skb;		/* When iavf_clean_rx_ring_irq() must
 					 * return before it sees the EOP for
 					 * the current packet, we save that skb
@@ -447,6 +521,20 @@ struct iavf_ring {
 #ifdef HAVE_XDP_BUFF_RXQ
 	struct xdp_rxq_info xdp_rxq;
 #endif
+	u8 *hdr_buf;			/* Rx header buffers, if split */
+	dma_addr_t hdr_dma;		/* physical address of hdr_buf */
+	u8 *tx_bounce;			/* Tx bounce buffers, one per desc */
+	dma_addr_t tx_bounce_dma;	/* physical address of tx_bounce */
+#ifdef HAVE_PAGE_POOL
+	struct page_pool *page_pool;	/* Rx buffers, if the pool is used */
+#endif /* HAVE_PAGE_POOL */
+	struct iavf_rx_page_cache *page_cache;	/* mapped pages, if cached */
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+	struct xsk_buff_pool *xsk_pool;
+#ifndef HAVE_NETDEV_BPF_XSK_POOL
+	struct zero_copy_allocator zca; /* ZC allocator anchor */
+#endif /* !HAVE_NETDEV_BPF_XSK_POOL */
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
 } ____cacheline_internodealigned_in_smp;
 
 static inline bool ring_ch_ena(struct iavf_ring *ring)
@@ -474,6 +562,79 @@ static inline void clear_ring_build_skb_enabled(struct iavf_ring *ring)
 	ring->flags &= ~IAVF_RXR_FLAGS_BUILD_SKB_ENABLED;
 }
 
+static inline bool ring_uses_hdr_split(struct iavf_ring *ring)
+{
+	return !!(ring->flags & IAVF_RXR_FLAGS_HDR_SPLIT);
+}
+
+static inline bool ring_uses_16byte_desc(struct iavf_ring *ring)
+{
+	return !!(ring->flags & IAVF_RXR_FLAGS_DESC_16B);
+}
+
+static inline bool ring_uses_head_wb(struct iavf_ring *ring)
+{
+	return !!(ring->flags & IAVF_TXR_FLAGS_HEAD_WB);
+}
+
+static inline bool ring_defers_doorbell(struct iavf_ring *ring)
+{
+	return !!(ring->flags & IAVF_TXR_FLAGS_DB_DEFER);
+}
+
+/**
+ * iavf_get_head - Retrieve head from head writeback
+ * @tx_ring: Tx ring to fetch head of
+ *
+ * Returns value of Tx ring head based on value stored
+ * in head write-back location, right after the descriptors
+ **/
+static inline u32 iavf_get_head(struct iavf_ring *tx_ring)
+{
+	void *head = (struct iavf_tx_desc *)tx_ring->desc + tx_ring->count;
+
+	return le32_to_cpu(*(volatile __le32 *)head);
+}
+
+/**
+ * iavf_tx_done - Check if a packet has been transmitted
+ * @tx_ring: Tx ring the packet was placed on
+ * @tx_head: descriptor at the head writeback, NULL if not in use
+ * @tx_desc: first descriptor of the packet
+ * @eop_desc: last descriptor of the packet
+ *
+ * With head writeback the head only ever stops past an RS descriptor, so
+ * a packet is done once the head moved on from its first descriptor and
+ * no descriptor has to be read.  Until the head moves for the first time
+ * the descriptor is checked as well, and if it was written back the PF
+ * ignored the head writeback request and the ring goes back to DD checks.
+ **/
+static inline bool iavf_tx_done(struct iavf_ring *tx_ring,
+				struct iavf_tx_desc **tx_head,
+				struct iavf_tx_desc *tx_desc,
+				struct iavf_tx_desc *eop_desc)
+{
+	bool dd;
+
+	if (*tx_head && *tx_head != tx_desc) {
+		tx_ring->flags |= IAVF_TXR_FLAGS_HEAD_WB_SEEN;
+		return true;
+	}
+
+	if (*tx_head && (tx_ring->flags & IAVF_TXR_FLAGS_HEAD_WB_SEEN))
+		return false;
+
+	dd = !!(eop_desc->cmd_type_offset_bsz &
+		cpu_to_le64(IAVF_TX_DESC_DTYPE_DESC_DONE));
+	if (dd && *tx_head) {
+		tx_ring->flags &= ~IAVF_TXR_FLAGS_HEAD_WB;
+		tx_ring->tx_stats.tx_head_wb_off++;
+		*tx_head = NULL;
+	}
+
+	return dd;
+}
+
 #define IAVF_ITR_ADAPTIVE_MIN_INC       0x0002
 #define IAVF_ITR_ADAPTIVE_MIN_USECS     0x0002
 #define IAVF_ITR_ADAPTIVE_MAX_USECS     0x007e
@@ -499,6 +660,9 @@ struct iavf_ring_container {
 	u16 count;
 	u16 target_itr;			/* target ITR setting for ring(s) */
 	u16 current_itr;		/* current ITR setting for ring(s) */
+#ifdef HAVE_DIM
+	struct dim dim;			/* DIM state when it drives the ITR */
+#endif /* HAVE_DIM */
 };
 
 /* iterator for handling rings in ring container */
@@ -516,6 +680,87 @@ static inline unsigned int iavf_rx_pg_order(struct iavf_ring *ring)
 
 #define iavf_rx_pg_size(_ring) (PAGE_SIZE << iavf_rx_pg_order(_ring))
 
+/**
+ * iavf_rx_uses_page_pool - check if an Rx ring is backed by a page_pool
+ * @ring: Rx ring
+ *
+ * A page_pool backed ring hands out a whole page per buffer, whatever the
+ * page size.
+ **/
+static inline bool iavf_rx_uses_page_pool(struct iavf_ring *ring)
+{
+#ifdef HAVE_PAGE_POOL
+	return !!ring->page_pool;
+#else
+	return false;
+#endif /* HAVE_PAGE_POOL */
+}
+
+/**
+ * iavf_rx_buf_truesize - size of the page region backing one Rx buffer
+ * @ring: Rx ring
+ *
+ * Buffers normally take half a page and the halves are flipped, a page_pool
+ * backed ring hands out a whole page per buffer instead.
+ **/
+static inline unsigned int iavf_rx_buf_truesize(struct iavf_ring *ring)
+{
+	if (iavf_rx_uses_page_pool(ring))
+		return iavf_rx_pg_size(ring);
+	return iavf_rx_pg_size(ring) / 2;
+}
+
+static inline __le64 build_ctob(u32 td_cmd, u32 td_offset, unsigned int size,
+				u32 td_tag)
+{
+	return cpu_to_le64(IAVF_TX_DESC_DTYPE_DATA |
+			   ((u64)td_cmd  << IAVF_TXD_QW1_CMD_SHIFT) |
+			   ((u64)td_offset << IAVF_TXD_QW1_OFFSET_SHIFT) |
+			   ((u64)size  << IAVF_TXD_QW1_TX_BUF_SZ_SHIFT) |
+			   ((u64)td_tag  << IAVF_TXD_QW1_L2TAG1_SHIFT));
+}
+
+#define IAVF_TXD_CMD (IAVF_TX_DESC_CMD_EOP | IAVF_TX_DESC_CMD_RS)
+
+/**
+ * iavf_release_rx_desc - Store the new tail and head values
+ * @rx_ring: ring to bump
+ * @val: new head index
+ **/
+static inline void iavf_release_rx_desc(struct iavf_ring *rx_ring, u32 val)
+{
+	rx_ring->next_to_use = val;
+
+	/* update next to alloc since we have filled the ring */
+	rx_ring->next_to_alloc = val;
+
+	/* Force memory writes to complete before letting h/w
+	 * know there are new descriptors to fetch.  (Only
+	 * applicable for weak-ordered memory model archs,
+	 * such as IA-64).
+	 */
+	wmb();
+	writel(val, rx_ring->tail);
+}
+
+/**
+ * iavf_xdp_ring_update_tail - Updates the XDP Tx ring tail register
+ * @xdp_ring: XDP Tx ring
+ **/
+static inline void iavf_xdp_ring_update_tail(struct iavf_ring *xdp_ring)
+{
+	/* Force memory writes to complete before letting h/w
+	 * know there are new descriptors to fetch.
+	 */
+	wmb();
+	writel_relaxed(xdp_ring->next_to_use, xdp_ring->tail);
+}
+
+#define IAVF_XDP_PASS          0
+#define IAVF_XDP_CONSUMED      BIT(0)
+#define IAVF_XDP_TX            BIT(1)
+#define IAVF_XDP_REDIR         BIT(2)
+
 bool iavf_alloc_rx_buffers(struct iavf_ring *rxr, u16 cleaned_count);
 netdev_tx_t iavf_lan_xmit_frame(struct sk_buff *skb, struct net_device *netdev);
 void iavf_clean_tx_ring(struct iavf_ring *tx_ring);
@@ -524,19 +769,35 @@ int iavf_setup_tx_descriptors(struct iavf_ring *tx_ring);
 int iavf_setup_rx_descriptors(struct iavf_ring *rx_ring);
 void iavf_free_tx_resources(struct iavf_ring *tx_ring);
 void iavf_free_rx_resources(struct iavf_ring *rx_ring);
+int iavf_setup_rx_hdr_split(struct iavf_ring *rx_ring);
+#ifdef HAVE_PAGE_POOL
+int iavf_setup_rx_page_pool(struct iavf_ring *rx_ring);
+#endif /* HAVE_PAGE_POOL */
+int iavf_setup_rx_page_cache(struct iavf_ring *rx_ring);
 int iavf_napi_poll(struct napi_struct *napi, int budget);
+#ifdef HAVE_DIM
+void iavf_dim_work(struct work_struct *work);
+#endif /* HAVE_DIM */
 u32 iavf_get_tx_pending(struct iavf_ring *ring, bool in_sw);
 void iavf_detect_recover_hung(struct iavf_vsi *vsi);
 void iavf_chnl_detect_recover(struct iavf_vsi *vsi);
 int __iavf_maybe_stop_tx(struct iavf_ring *tx_ring, int size);
 bool __iavf_chk_linearize(struct sk_buff *skb);
-#ifdef HAVE_XDP_FRAME_STRUCT
+void iavf_process_skb_fields(struct iavf_ring *rx_ring,
+			     union iavf_rx_desc *rx_desc, struct sk_buff *skb,
+			     u8 rx_ptype);
+void iavf_receive_skb(struct iavf_ring *rx_ring, struct sk_buff *skb,
+		      u16 vlan_tag);
+#ifdef HAVE_XDP_SUPPORT
+int iavf_xmit_xdp_tx_ring(struct xdp_buff *xdp, struct iavf_ring *xdp_ring);
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+int iavf_xmit_xdp_tx_ring_zc(struct xdp_buff *xdp, struct iavf_ring *xdp_ring);
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+#endif /* HAVE_XDP_SUPPORT */
+#ifdef HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS
 int iavf_xdp_xmit(struct net_device *dev, int n, struct xdp_frame **frames,
 		  u32 flags);
-#else
-int iavf_xdp_xmit(struct net_device *dev, struct xdp_buff *xdp);
-#endif
-void iavf_xdp_flush(struct net_device *dev);
+#endif /* HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS */
 
 
 /**
@@ -137,6 +137,7 @@ int iavf_send_vf_config_msg(struct iavf_adapter *adapter)
 	       VIRTCHNL_VF_OFFLOAD_ADQ_V2 |
 #endif /* __TC_MQPRIO_MODE_MAX */
 	       VIRTCHNL_VF_OFFLOAD_USO |
+	       VIRTCHNL_VF_OFFLOAD_RX_FLEX_DESC |
 #ifdef VIRTCHNL_VF_CAP_ADV_LINK_SPEED
 	       VIRTCHNL_VF_OFFLOAD_ENCAP_CSUM |
 	       VIRTCHNL_VF_CAP_ADV_LINK_SPEED;
@@ -253,7 +254,7 @@ void iavf_configure_queues(struct iavf_adapter *adapter)
 {
 	struct virtchnl_vsi_queue_config_info *vqci;
 	struct virtchnl_queue_pair_info *vqpi;
-	int pairs = adapter->num_active_queues;
+	int pairs = iavf_num_tx_rings(adapter);
 	int i, len;
 
 	if (adapter->current_op != VIRTCHNL_OP_UNKNOWN) {
@@ -280,15 +281,38 @@ void iavf_configure_queues(struct iavf_adapter *adapter)
 		vqpi->txq.queue_id = i;
 		vqpi->txq.ring_len = adapter->tx_rings[i].count;
 		vqpi->txq.dma_ring_addr = adapter->tx_rings[i].dma;
+		if (ring_uses_head_wb(&adapter->tx_rings[i])) {
+			vqpi->txq.headwb_enabled = 1;
+			vqpi->txq.dma_headwb_addr =
+				adapter->tx_rings[i].dma +
+				adapter->tx_rings[i].count *
+				sizeof(struct iavf_tx_desc);
+		}
 		vqpi->rxq.vsi_id = vqci->vsi_id;
 		vqpi->rxq.queue_id = i;
-		vqpi->rxq.ring_len = adapter->rx_rings[i].count;
-		vqpi->rxq.dma_ring_addr = adapter->rx_rings[i].dma;
 		vqpi->rxq.max_pkt_size = adapter->netdev->mtu +
 					 IAVF_PACKET_HDR_PAD;
-		vqpi->rxq.databuffer_size =
-			ALIGN(adapter->rx_rings[i].rx_buf_len,
-			      BIT_ULL(IAVF_RXQ_CTX_DBUFF_SHIFT));
+		/* pairs past the active queues only carry an XDP Tx ring,
+		 * their Rx queue is left without a ring and never enabled
+		 */
+		if (i < adapter->num_active_queues) {
+			vqpi->rxq.ring_len = adapter->rx_rings[i].count;
+			vqpi->rxq.dma_ring_addr = adapter->rx_rings[i].dma;
+			vqpi->rxq.databuffer_size =
+				ALIGN(adapter->rx_rings[i].rx_buf_len,
+				      BIT_ULL(IAVF_RXQ_CTX_DBUFF_SHIFT));
+			/* rxdid is ignored unless the PF lets us choose */
+			if (!ring_uses_16byte_desc(&adapter->rx_rings[i]))
+				vqpi->rxq.rxdid = VIRTCHNL_RXDID_1_32B_BASE;
+			if (ring_uses_hdr_split(&adapter->rx_rings[i])) {
+				vqpi->rxq.hdr_size = IAVF_RX_HDR_SIZE;
+				vqpi->rxq.splithdr_enabled = 1;
+				vqpi->rxq.rx_split_pos = IAVF_RX_SPLIT_L2 |
+							 IAVF_RX_SPLIT_IP |
+							 IAVF_RX_SPLIT_TCP_UDP |
+							 IAVF_RX_SPLIT_SCTP;
+			}
+		}
 		vqpi++;
 	}
 
@@ -316,8 +340,8 @@ void iavf_enable_queues(struct iavf_adapter *adapter)
 	}
 	adapter->current_op = VIRTCHNL_OP_ENABLE_QUEUES;
 	vqs.vsi_id = adapter->vsi_res->vsi_id;
-	vqs.tx_queues = BIT(adapter->num_active_queues) - 1;
-	vqs.rx_queues = vqs.tx_queues;
+	vqs.tx_queues = BIT(iavf_num_tx_rings(adapter)) - 1;
+	vqs.rx_queues = BIT(adapter->num_active_queues) - 1;
 	adapter->aq_required &= ~IAVF_FLAG_AQ_ENABLE_QUEUES;
 	iavf_send_pf_msg(adapter, VIRTCHNL_OP_ENABLE_QUEUES,
 			 (u8 *)&vqs, sizeof(vqs));
@@ -341,8 +365,8 @@ void iavf_disable_queues(struct iavf_adapter *adapter)
 	}
 	adapter->current_op = VIRTCHNL_OP_DISABLE_QUEUES;
 	vqs.vsi_id = adapter->vsi_res->vsi_id;
-	vqs.tx_queues = BIT(adapter->num_active_queues) - 1;
-	vqs.rx_queues = vqs.tx_queues;
+	vqs.tx_queues = BIT(iavf_num_tx_rings(adapter)) - 1;
+	vqs.rx_queues = BIT(adapter->num_active_queues) - 1;
 	adapter->aq_required &= ~IAVF_FLAG_AQ_DISABLE_QUEUES;
 	iavf_send_pf_msg(adapter, VIRTCHNL_OP_DISABLE_QUEUES,
 			 (u8 *)&vqs, sizeof(vqs));
@@ -359,7 +383,7 @@ void iavf_map_queues(struct iavf_adapter *adapter)
 {
 	struct virtchnl_irq_map_info *vimi;
 	struct virtchnl_vector_map *vecmap;
-	int v_idx, q_vectors, len;
+	int v_idx, q_vectors, len, i;
 	struct iavf_q_vector *q_vector;
 
 	if (adapter->current_op != VIRTCHNL_OP_UNKNOWN) {
@@ -388,10 +412,21 @@ void iavf_map_queues(struct iavf_adapter *adapter)
 		vecmap->vsi_id = adapter->vsi_res->vsi_id;
 		vecmap->vector_id = v_idx + NONQ_VECS;
 		vecmap->txq_map = q_vector->ring_mask;
+		/* XDP Tx ring N is serviced together with queue pair N */
+		if (adapter->num_xdp_queues)
+			vecmap->txq_map |= q_vector->ring_mask <<
+					   adapter->num_active_queues;
 		vecmap->rxq_map = q_vector->ring_mask;
 		vecmap->rxitr_idx = IAVF_RX_ITR;
 		vecmap->txitr_idx = IAVF_TX_ITR;
 	}
+	/* ndo_xdp_xmit rings go to whichever vector cleans them */
+	for (i = 0; i < adapter->num_xdp_xmit_queues; i++) {
+		struct iavf_ring *xdp_ring = adapter->vsi.xdp_xmit_rings[i];
+
+		vecmap = &vimi->vecmap[xdp_ring->q_vector->v_idx];
+		vecmap->txq_map |= BIT(xdp_ring->queue_index);
+	}
 	/* Misc vector last - this is only for AdminQ messages */
 	vecmap = &vimi->vecmap[v_idx];
 	vecmap->vsi_id = adapter->vsi_res->vsi_id;
@@ -411,7 +446,8 @@ void iavf_map_queues(struct iavf_adapter *adapter)
  * @num: number of requested queues
  *
  * We get a default number of queues from the PF.  This enables us to request a
- * different number.  Returns 0 on success, negative on failure
+ * different number, callers needing more queues than CPUs, like XDP, can.
+ * Returns 0 on success, negative on failure
  **/
 int iavf_request_queues(struct iavf_adapter *adapter, int num)
 {
@@ -424,7 +460,7 @@ int iavf_request_queues(struct iavf_adapter *adapter, int num)
 		return -EBUSY;
 	}
 
-	vfres.num_queue_pairs = min_t(int, num, num_online_cpus());
+	vfres.num_queue_pairs = min_t(int, num, IAVF_MAX_REQ_QUEUES);
 
 	adapter->current_op = VIRTCHNL_OP_REQUEST_QUEUES;
 	adapter->flags |= IAVF_FLAG_REINIT_ITR_NEEDED;
@@ -1770,6 +1806,18 @@ void iavf_virtchnl_completion(struct iavf_adapter *adapter,
 					v_opcode, v_retval);
 				adapter->flags |= IAVF_FLAG_CHNL_CFG_FAILED;
 			}
+
+			/* the PF lets us pick the descriptor format, but not
+			 * every PF supports the 16-byte one, go back to the
+			 * 32-byte descriptors
+			 */
+			if (v_opcode == VIRTCHNL_OP_CONFIG_VSI_QUEUES &&
+			    (adapter->flags & IAVF_FLAG_RX_DESC_16B)) {
+				dev_warn(&adapter->pdev->dev,
+					 "PF rejected 16-byte Rx descriptors, falling back to 32-byte descriptors\n");
+				adapter->flags &= ~IAVF_FLAG_RX_DESC_16B;
+				iavf_schedule_reset(adapter);
+			}
 		}
 	}
 	switch (v_opcode) {
@@ -1805,6 +1853,8 @@ void iavf_virtchnl_completion(struct iavf_adapter *adapter,
 			  sizeof(struct virtchnl_vsi_resource);
 
 		memcpy(adapter->vf_res, msg, min(msglen, len));
+		/* the reset that granted the XDP queues, if any, is done */
+		adapter->flags &= ~IAVF_FLAG_XDP_REQ_QUEUES;
 		iavf_validate_num_queues(adapter);
 		iavf_vf_parse_hw_config(&adapter->hw, adapter->vf_res);
 		if (is_zero_ether_addr(adapter->hw.mac.addr)) {
@@ -1925,6 +1975,19 @@ void iavf_virtchnl_completion(struct iavf_adapter *adapter,
 	case VIRTCHNL_OP_REQUEST_QUEUES: {
 		struct virtchnl_vf_res_request *vfres =
 			(struct virtchnl_vf_res_request *)msg;
+
+		/* The PF only answers requests it can't grant.  XDP still
+		 * comes up, with fewer ndo_xdp_xmit rings, on the queue
+		 * pairs we already have.
+		 */
+		if (adapter->flags & IAVF_FLAG_XDP_REQ_QUEUES) {
+			adapter->flags &= ~IAVF_FLAG_XDP_REQ_QUEUES;
+			dev_info(&adapter->pdev->dev,
+				 "PF can support %d queues, XDP shares the remaining Tx queues between CPUs\n",
+				 vfres->num_queue_pairs);
+			iavf_schedule_reset(adapter);
+			break;
+		}
 		if (vfres->num_queue_pairs != adapter->num_req_queues) {
 			dev_info(&adapter->pdev->dev,
 				 "Requested %d queues, PF can support %d\n",
@@ -0,0 +1,1289 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (c) 2013, Intel Corporation. */
+
+#include <linux/prefetch.h>
+#include "iavf.h"
+
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+/**
+ * iavf_xsk_pool - Retrieve the buffer pool registered for a queue
+ * @adapter: board private structure
+ * @qid: queue id, the Rx queue index or the index of its XDP Tx ring
+ *
+ * Zero-copy is only used while an XDP program is attached, since that is
+ * what steers frames into the AF_XDP socket.
+ *
+ * Returns the pool or NULL if the queue runs in copy mode
+ **/
+struct xsk_buff_pool *iavf_xsk_pool(struct iavf_adapter *adapter, u16 qid)
+{
+	struct iavf_vsi *vsi = &adapter->vsi;
+
+	if (!READ_ONCE(vsi->xdp_prog) || !vsi->xsk_pools ||
+	    qid >= vsi->num_xsk_pools)
+		return NULL;
+
+	return vsi->xsk_pools[qid];
+}
+
+/**
+ * iavf_xsk_rx_buf_len - Rx buffer length used for a pool
+ * @pool: pool backing the Rx ring
+ *
+ * The hardware needs the buffer size in 128 byte units, so round the usable
+ * part of a chunk down to keep the device from writing past the chunk.
+ **/
+static u16 iavf_xsk_rx_buf_len(struct xsk_buff_pool *pool)
+{
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+	return ALIGN_DOWN(xsk_pool_get_rx_frame_size(pool),
+			  BIT_ULL(IAVF_RXQ_CTX_DBUFF_SHIFT));
+#else
+	return ALIGN_DOWN(pool->chunk_size_nohr - XDP_PACKET_HEADROOM,
+			  BIT_ULL(IAVF_RXQ_CTX_DBUFF_SHIFT));
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+}
+
+#ifndef HAVE_NETDEV_BPF_XSK_POOL
+/**
+ * iavf_xsk_umem_dma_map - DMA map all pages of a umem
+ * @adapter: board private structure
+ * @umem: umem to map
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_umem_dma_map(struct iavf_adapter *adapter,
+				 struct xdp_umem *umem)
+{
+	struct device *dev = pci_dev_to_dev(adapter->pdev);
+	unsigned int i, j;
+	dma_addr_t dma;
+
+	for (i = 0; i < umem->npgs; i++) {
+		dma = dma_map_page_attrs(dev, umem->pgs[i], 0, PAGE_SIZE,
+					 DMA_BIDIRECTIONAL, IAVF_RX_DMA_ATTR);
+		if (dma_mapping_error(dev, dma))
+			goto out_unmap;
+
+		umem->pages[i].dma = dma;
+	}
+
+	return 0;
+
+out_unmap:
+	for (j = 0; j < i; j++) {
+		dma_unmap_page_attrs(dev, umem->pages[j].dma, PAGE_SIZE,
+				     DMA_BIDIRECTIONAL, IAVF_RX_DMA_ATTR);
+		umem->pages[j].dma = 0;
+	}
+
+	return -ENOMEM;
+}
+
+/**
+ * iavf_xsk_umem_dma_unmap - DMA unmap all pages of a umem
+ * @adapter: board private structure
+ * @umem: umem to unmap
+ **/
+static void iavf_xsk_umem_dma_unmap(struct iavf_adapter *adapter,
+				    struct xdp_umem *umem)
+{
+	struct device *dev = pci_dev_to_dev(adapter->pdev);
+	unsigned int i;
+
+	for (i = 0; i < umem->npgs; i++) {
+		dma_unmap_page_attrs(dev, umem->pages[i].dma, PAGE_SIZE,
+				     DMA_BIDIRECTIONAL, IAVF_RX_DMA_ATTR);
+		umem->pages[i].dma = 0;
+	}
+}
+
+#endif /* !HAVE_NETDEV_BPF_XSK_POOL */
+/**
+ * iavf_xsk_pool_add - Store a pool for a queue
+ * @vsi: VSI the pool is bound to
+ * @pool: pool to store
+ * @qid: queue id
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_pool_add(struct iavf_vsi *vsi,
+			     struct xsk_buff_pool *pool, u16 qid)
+{
+	if (!vsi->xsk_pools) {
+		vsi->xsk_pools = kcalloc(IAVF_MAX_REQ_QUEUES,
+					 sizeof(*vsi->xsk_pools), GFP_KERNEL);
+		if (!vsi->xsk_pools)
+			return -ENOMEM;
+		vsi->num_xsk_pools = IAVF_MAX_REQ_QUEUES;
+	}
+
+	vsi->xsk_pools[qid] = pool;
+	vsi->num_xsk_pools_used++;
+
+	return 0;
+}
+
+/**
+ * iavf_xsk_pool_remove - Forget the pool of a queue
+ * @vsi: VSI the pool is bound to
+ * @qid: queue id
+ **/
+static void iavf_xsk_pool_remove(struct iavf_vsi *vsi, u16 qid)
+{
+	vsi->xsk_pools[qid] = NULL;
+	vsi->num_xsk_pools_used--;
+
+	if (!vsi->num_xsk_pools_used) {
+		kfree(vsi->xsk_pools);
+		vsi->xsk_pools = NULL;
+		vsi->num_xsk_pools = 0;
+	}
+}
+
+/**
+ * iavf_xsk_restart - Bring the rings back up after a umem change
+ * @adapter: board private structure
+ * @qid: queue to kick once the rings are up
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_restart(struct iavf_adapter *adapter, u16 qid)
+{
+	int err;
+
+	err = iavf_open(adapter->netdev);
+	if (err)
+		return err;
+
+	/* Kick start the NAPI context so that receiving will start, the
+	 * fill ring is usually still empty when the rings are configured.
+	 */
+#ifdef HAVE_NDO_XSK_WAKEUP
+	return iavf_xsk_wakeup(adapter->netdev, qid, XDP_WAKEUP_RX);
+#else
+	return iavf_xsk_async_xmit(adapter->netdev, qid);
+#endif /* HAVE_NDO_XSK_WAKEUP */
+}
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+/**
+ * iavf_xsk_pool_enable - Enable zero-copy on a queue
+ * @adapter: board private structure
+ * @pool: buffer pool to use for the queue
+ * @qid: queue id
+ *
+ * The rings only change while the interface is down, so a running interface
+ * is closed and reopened around the change, the same way a queue pair is
+ * restarted on the PF.
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_pool_enable(struct iavf_adapter *adapter,
+				struct xsk_buff_pool *pool, u16 qid)
+{
+	struct net_device *netdev = adapter->netdev;
+	bool if_running;
+	int err;
+
+	if (qid >= adapter->num_active_queues || qid >= IAVF_MAX_REQ_QUEUES)
+		return -EINVAL;
+
+	if (adapter->vsi.xsk_pools && adapter->vsi.xsk_pools[qid])
+		return -EBUSY;
+
+	/* frames can't span chunks, the whole frame has to fit in one */
+	if (netdev->mtu + IAVF_PACKET_HDR_PAD > iavf_xsk_rx_buf_len(pool)) {
+		netdev_info(netdev, "MTU too large for the umem chunk size\n");
+		return -EINVAL;
+	}
+
+	err = xsk_pool_dma_map(pool, pci_dev_to_dev(adapter->pdev),
+			       IAVF_RX_DMA_ATTR);
+	if (err)
+		return err;
+
+	if_running = netif_running(netdev) && adapter->vsi.xdp_prog;
+	if (if_running)
+		iavf_close(netdev);
+
+	err = iavf_xsk_pool_add(&adapter->vsi, pool, qid);
+	if (err) {
+		xsk_pool_dma_unmap(pool, IAVF_RX_DMA_ATTR);
+		if (if_running)
+			iavf_open(netdev);
+		return err;
+	}
+
+	if (if_running)
+		return iavf_xsk_restart(adapter, qid);
+
+	return 0;
+}
+
+/**
+ * iavf_xsk_pool_disable - Disable zero-copy on a queue
+ * @adapter: board private structure
+ * @qid: queue id
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_pool_disable(struct iavf_adapter *adapter, u16 qid)
+{
+	struct net_device *netdev = adapter->netdev;
+	struct xsk_buff_pool *pool;
+	bool if_running;
+
+	if (!adapter->vsi.xsk_pools || qid >= adapter->vsi.num_xsk_pools)
+		return -EINVAL;
+
+	pool = adapter->vsi.xsk_pools[qid];
+	if (!pool)
+		return -EINVAL;
+
+	if_running = netif_running(netdev) && adapter->vsi.xdp_prog;
+	if (if_running)
+		iavf_close(netdev);
+
+	xsk_pool_dma_unmap(pool, IAVF_RX_DMA_ATTR);
+	iavf_xsk_pool_remove(&adapter->vsi, qid);
+
+	if (if_running)
+		return iavf_open(netdev);
+
+	return 0;
+}
+
+/**
+ * iavf_xsk_pool_setup - Enable/disable a buffer pool on a queue
+ * @adapter: board private structure
+ * @pool: pool to enable, NULL to disable
+ * @qid: queue id
+ *
+ * Returns 0 on success, negative on failure
+ **/
+int iavf_xsk_pool_setup(struct iavf_adapter *adapter,
+			struct xsk_buff_pool *pool, u16 qid)
+{
+	return pool ? iavf_xsk_pool_enable(adapter, pool, qid) :
+		      iavf_xsk_pool_disable(adapter, qid);
+}
+#else
+/**
+ * iavf_xsk_umem_enable - Enable zero-copy on a queue
+ * @adapter: board private structure
+ * @umem: umem to use for the queue
+ * @qid: queue id
+ *
+ * The rings only change while the interface is down, so a running interface
+ * is closed and reopened around the change, the same way a queue pair is
+ * restarted on the PF.  The reuse queue of the umem is only replaced once
+ * nothing can fail any more, a rejected umem is left as it was.
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_umem_enable(struct iavf_adapter *adapter,
+				struct xdp_umem *umem, u16 qid)
+{
+	struct net_device *netdev = adapter->netdev;
+	struct xdp_umem_fq_reuse *reuseq;
+	bool if_running;
+	int err;
+
+	if (qid >= adapter->num_active_queues || qid >= IAVF_MAX_REQ_QUEUES)
+		return -EINVAL;
+
+	if (adapter->vsi.xsk_pools && adapter->vsi.xsk_pools[qid])
+		return -EBUSY;
+
+	/* frames can't span chunks, the whole frame has to fit in one */
+	if (netdev->mtu + IAVF_PACKET_HDR_PAD > iavf_xsk_rx_buf_len(umem)) {
+		netdev_info(netdev, "MTU too large for the umem chunk size\n");
+		return -EINVAL;
+	}
+
+	reuseq = xsk_reuseq_prepare(adapter->rx_desc_count);
+	if (!reuseq)
+		return -ENOMEM;
+
+	err = iavf_xsk_umem_dma_map(adapter, umem);
+	if (err)
+		goto err_free_reuseq;
+
+	if_running = netif_running(netdev) && adapter->vsi.xdp_prog;
+	if (if_running)
+		iavf_close(netdev);
+
+	err = iavf_xsk_pool_add(&adapter->vsi, umem, qid);
+	if (err) {
+		iavf_xsk_umem_dma_unmap(adapter, umem);
+		if (if_running)
+			iavf_open(netdev);
+		goto err_free_reuseq;
+	}
+
+	xsk_reuseq_free(xsk_reuseq_swap(umem, reuseq));
+
+	if (if_running)
+		return iavf_xsk_restart(adapter, qid);
+
+	return 0;
+
+err_free_reuseq:
+	xsk_reuseq_free(reuseq);
+	return err;
+}
+
+/**
+ * iavf_xsk_umem_disable - Disable zero-copy on a queue
+ * @adapter: board private structure
+ * @qid: queue id
+ *
+ * Returns 0 on success, negative on failure
+ **/
+static int iavf_xsk_umem_disable(struct iavf_adapter *adapter, u16 qid)
+{
+	struct net_device *netdev = adapter->netdev;
+	struct xdp_umem *umem;
+	bool if_running;
+
+	if (!adapter->vsi.xsk_pools || qid >= adapter->vsi.num_xsk_pools)
+		return -EINVAL;
+
+	umem = adapter->vsi.xsk_pools[qid];
+	if (!umem)
+		return -EINVAL;
+
+	if_running = netif_running(netdev) && adapter->vsi.xdp_prog;
+	if (if_running)
+		iavf_close(netdev);
+
+	iavf_xsk_umem_dma_unmap(adapter, umem);
+	iavf_xsk_pool_remove(&adapter->vsi, qid);
+
+	if (if_running)
+		return iavf_open(netdev);
+
+	return 0;
+}
+
+#ifndef NO_XDP_QUERY_XSK_UMEM
+/**
+ * iavf_xsk_umem_query - Query the umem bound to a queue
+ * @adapter: board private structure
+ * @umem: filled in with the umem, or NULL
+ * @qid: queue id
+ *
+ * Returns 0 on success, negative on failure
+ **/
+int iavf_xsk_umem_query(struct iavf_adapter *adapter, struct xdp_umem **umem,
+			u16 qid)
+{
+	if (qid >= adapter->num_active_queues)
+		return -EINVAL;
+
+	if (adapter->vsi.xsk_pools && qid < adapter->vsi.num_xsk_pools)
+		*umem = adapter->vsi.xsk_pools[qid];
+	else
+		*umem = NULL;
+
+	return 0;
+}
+
+#endif /* NO_XDP_QUERY_XSK_UMEM */
+/**
+ * iavf_xsk_umem_setup - Enable/disable a umem on a queue
+ * @adapter: board private structure
+ * @umem: umem to enable, NULL to disable
+ * @qid: queue id
+ *
+ * Returns 0 on success, negative on failure
+ **/
+int iavf_xsk_umem_setup(struct iavf_adapter *adapter, struct xdp_umem *umem,
+			u16 qid)
+{
+	return umem ? iavf_xsk_umem_enable(adapter, umem, qid) :
+		      iavf_xsk_umem_disable(adapter, qid);
+}
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+/**
+ * iavf_xsk_configure_rx_ring - Set up an Rx ring for zero-copy or copy mode
+ * @rx_ring: Rx ring, with its default buffer length already set
+ *
+ * Called every time the rings are configured; picks the memory model
+ * matching whether a pool is bound to the queue.
+ **/
+void iavf_xsk_configure_rx_ring(struct iavf_ring *rx_ring)
+{
+	struct iavf_adapter *adapter = rx_ring->vsi->back;
+	int err;
+
+	xdp_rxq_info_unreg_mem_model(&rx_ring->xdp_rxq);
+
+	rx_ring->xsk_pool = iavf_xsk_pool(adapter, rx_ring->queue_index);
+	if (rx_ring->xsk_pool) {
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+		err = xdp_rxq_info_reg_mem_model(&rx_ring->xdp_rxq,
+						 MEM_TYPE_XSK_BUFF_POOL, NULL);
+#else
+		rx_ring->zca.free = iavf_zca_free;
+		err = xdp_rxq_info_reg_mem_model(&rx_ring->xdp_rxq,
+						 MEM_TYPE_ZERO_COPY,
+						 &rx_ring->zca);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+		if (!err) {
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+			xsk_pool_set_rxq_info(rx_ring->xsk_pool,
+					      &rx_ring->xdp_rxq);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+			rx_ring->rx_buf_len =
+				iavf_xsk_rx_buf_len(rx_ring->xsk_pool);
+			clear_ring_build_skb_enabled(rx_ring);
+			return;
+		}
+
+		dev_info(&adapter->pdev->dev, "Failed to enable zero-copy on Rx queue %d, falling back to copy mode\n",
+			 rx_ring->queue_index);
+	}
+
+	rx_ring->xsk_pool = NULL;
+	xdp_rxq_info_reg_mem_model(&rx_ring->xdp_rxq, MEM_TYPE_PAGE_SHARED,
+				   NULL);
+}
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+/**
+ * iavf_alloc_buffer_zc - Allocate an Rx buffer from the pool
+ * @rx_ring: Rx ring
+ * @bi: Rx buffer to populate
+ *
+ * The pool syncs the buffer for the device itself when that is needed.
+ *
+ * Returns true if the buffer holds a chunk
+ **/
+static __always_inline bool iavf_alloc_buffer_zc(struct iavf_ring *rx_ring,
+						 struct iavf_rx_buffer *bi)
+{
+	bi->xdp = xsk_buff_alloc(rx_ring->xsk_pool);
+	if (!bi->xdp) {
+		rx_ring->rx_stats.alloc_page_failed++;
+		return false;
+	}
+
+	bi->dma = xsk_buff_xdp_get_dma(bi->xdp);
+
+	return true;
+}
+#else
+/**
+ * iavf_alloc_buffer_zc - Allocate an Rx buffer from the fill ring
+ * @rx_ring: Rx ring
+ * @bi: Rx buffer to populate
+ *
+ * Returns true if the buffer holds a chunk
+ **/
+static __always_inline bool iavf_alloc_buffer_zc(struct iavf_ring *rx_ring,
+						 struct iavf_rx_buffer *bi)
+{
+	struct xdp_umem *umem = rx_ring->xsk_pool;
+	u64 handle, hr;
+
+	if (bi->addr) {
+		rx_ring->rx_stats.page_reuse_count++;
+		return true;
+	}
+
+	if (!xsk_umem_peek_addr(umem, &handle)) {
+		rx_ring->rx_stats.alloc_page_failed++;
+		return false;
+	}
+
+	handle &= umem->chunk_mask;
+	hr = umem->headroom + XDP_PACKET_HEADROOM;
+
+	bi->dma = xdp_umem_get_dma(umem, handle);
+	bi->dma += hr;
+
+	bi->addr = xdp_umem_get_data(umem, handle);
+	bi->addr += hr;
+
+	bi->handle = handle + umem->headroom;
+
+	xsk_umem_release_addr(umem);
+
+	return true;
+}
+
+/**
+ * iavf_alloc_buffer_slow_zc - Allocate an Rx buffer from the reuse queue
+ * @rx_ring: Rx ring
+ * @bi: Rx buffer to populate
+ *
+ * Same as iavf_alloc_buffer_zc, but also looks at the buffers that were
+ * handed back to the umem when the ring was torn down.
+ *
+ * Returns true if the buffer holds a chunk
+ **/
+static __always_inline bool
+iavf_alloc_buffer_slow_zc(struct iavf_ring *rx_ring, struct iavf_rx_buffer *bi)
+{
+	struct xdp_umem *umem = rx_ring->xsk_pool;
+	u64 handle, hr;
+
+	if (!xsk_umem_peek_addr_rq(umem, &handle)) {
+		rx_ring->rx_stats.alloc_page_failed++;
+		return false;
+	}
+
+	handle &= umem->chunk_mask;
+	hr = umem->headroom + XDP_PACKET_HEADROOM;
+
+	bi->dma = xdp_umem_get_dma(umem, handle);
+	bi->dma += hr;
+
+	bi->addr = xdp_umem_get_data(umem, handle);
+	bi->addr += hr;
+
+	bi->handle = handle + umem->headroom;
+
+	xsk_umem_release_addr_rq(umem);
+
+	return true;
+}
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+static __always_inline bool
+__iavf_alloc_rx_buffers_zc(struct iavf_ring *rx_ring, u16 count,
+			   bool alloc(struct iavf_ring *rx_ring,
+				      struct iavf_rx_buffer *bi))
+{
+	u16 ntu = rx_ring->next_to_use;
+	union iavf_rx_desc *rx_desc;
+	struct iavf_rx_buffer *bi;
+	bool failure = false;
+
+	if (!count)
+		return false;
+
+	rx_desc = IAVF_RX_DESC(rx_ring, ntu);
+	bi = &rx_ring->rx_bi[ntu];
+
+	do {
+		if (!alloc(rx_ring, bi)) {
+			failure = true;
+			break;
+		}
+
+#ifndef HAVE_NETDEV_BPF_XSK_POOL
+		dma_sync_single_range_for_device(rx_ring->dev, bi->dma, 0,
+						 rx_ring->rx_buf_len,
+						 DMA_BIDIRECTIONAL);
+
+#endif /* !HAVE_NETDEV_BPF_XSK_POOL */
+		/* Refresh the desc even if buffer_addrs didn't change
+		 * because each write-back erases this info.
+		 */
+		rx_desc->read.pkt_addr = cpu_to_le64(bi->dma);
+
+		bi++;
+		ntu++;
+		if (unlikely(ntu == rx_ring->count)) {
+			bi = rx_ring->rx_bi;
+			ntu = 0;
+		}
+		/* the descriptor stride depends on the ring's format */
+		rx_desc = IAVF_RX_DESC(rx_ring, ntu);
+
+		/* clear the status bits for the next_to_use descriptor */
+		rx_desc->wb.qword1.status_error_len = 0;
+
+		count--;
+	} while (count);
+
+	if (rx_ring->next_to_use != ntu)
+		iavf_release_rx_desc(rx_ring, ntu);
+
+	return failure;
+}
+
+/**
+ * iavf_alloc_rx_buffers_zc - Allocate a number of Rx buffers
+ * @rx_ring: Rx ring
+ * @cleaned_count: number of buffers to allocate
+ *
+ * This function allocates a number of Rx buffers from the reuse queue
+ * or fill ring and places them on the Rx ring.
+ *
+ * Returns false if all allocations were successful, true if any fail
+ **/
+bool iavf_alloc_rx_buffers_zc(struct iavf_ring *rx_ring, u16 cleaned_count)
+{
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+	return __iavf_alloc_rx_buffers_zc(rx_ring, cleaned_count,
+					  iavf_alloc_buffer_zc);
+#else
+	return __iavf_alloc_rx_buffers_zc(rx_ring, cleaned_count,
+					  iavf_alloc_buffer_slow_zc);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+}
+
+/**
+ * iavf_alloc_rx_buffers_fast_zc - Allocate a number of Rx buffers
+ * @rx_ring: Rx ring
+ * @cleaned_count: number of buffers to allocate
+ *
+ * This function allocates a number of Rx buffers from the fill ring
+ * or the internal recycle mechanism and places them on the Rx ring.
+ *
+ * Returns false if all allocations were successful, true if any fail
+ **/
+static bool iavf_alloc_rx_buffers_fast_zc(struct iavf_ring *rx_ring,
+					  u16 cleaned_count)
+{
+	return __iavf_alloc_rx_buffers_zc(rx_ring, cleaned_count,
+					  iavf_alloc_buffer_zc);
+}
+
+/**
+ * iavf_get_rx_buffer_zc - Return the current Rx buffer
+ * @rx_ring: Rx ring
+ * @size: The size of the Rx buffer (read from descriptor)
+ *
+ * This function returns the current, received Rx buffer, and also
+ * does DMA synchronization for the Rx ring.
+ **/
+static struct iavf_rx_buffer *iavf_get_rx_buffer_zc(struct iavf_ring *rx_ring,
+						    const unsigned int size)
+{
+	struct iavf_rx_buffer *bi;
+
+	bi = &rx_ring->rx_bi[rx_ring->next_to_clean];
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+	bi->xdp->data_end = bi->xdp->data + size;
+	xsk_buff_dma_sync_for_cpu(bi->xdp, rx_ring->xsk_pool);
+#else
+	/* we are reusing so sync this buffer for CPU use */
+	dma_sync_single_range_for_cpu(rx_ring->dev, bi->dma, 0, size,
+				      DMA_BIDIRECTIONAL);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+	return bi;
+}
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+/**
+ * iavf_reuse_rx_buffer_zc - Recycle an Rx buffer
+ * @rx_ring: Rx ring
+ * @bi: The Rx buffer to recycle
+ *
+ * The buffer goes back to the free list of the pool, the next allocation
+ * picks it up again.
+ **/
+static void iavf_reuse_rx_buffer_zc(struct iavf_ring __always_unused *rx_ring,
+				    struct iavf_rx_buffer *bi)
+{
+	xsk_buff_free(bi->xdp);
+	bi->xdp = NULL;
+}
+#else
+/**
+ * iavf_reuse_rx_buffer_zc - Recycle an Rx buffer
+ * @rx_ring: Rx ring
+ * @old_bi: The Rx buffer to recycle
+ *
+ * This function recycles a finished Rx buffer, and places it on the
+ * recycle queue (next_to_alloc).
+ **/
+static void iavf_reuse_rx_buffer_zc(struct iavf_ring *rx_ring,
+				    struct iavf_rx_buffer *old_bi)
+{
+	struct iavf_rx_buffer *new_bi = &rx_ring->rx_bi[rx_ring->next_to_alloc];
+	unsigned long mask = (unsigned long)rx_ring->xsk_pool->chunk_mask;
+	u64 hr = rx_ring->xsk_pool->headroom + XDP_PACKET_HEADROOM;
+	u16 nta = rx_ring->next_to_alloc;
+
+	/* update, and store next to alloc */
+	nta++;
+	rx_ring->next_to_alloc = (nta < rx_ring->count) ? nta : 0;
+
+	/* transfer page from old buffer to new buffer */
+	new_bi->dma = old_bi->dma & mask;
+	new_bi->dma += hr;
+
+	new_bi->addr = (void *)((unsigned long)old_bi->addr & mask);
+	new_bi->addr += hr;
+
+	new_bi->handle = old_bi->handle & mask;
+	new_bi->handle += rx_ring->xsk_pool->headroom;
+
+	old_bi->addr = NULL;
+}
+
+/**
+ * iavf_zca_free - Free callback for MEM_TYPE_ZERO_COPY allocations
+ * @alloc: Zero-copy allocator
+ * @handle: Buffer handle
+ **/
+void iavf_zca_free(struct zero_copy_allocator *alloc, unsigned long handle)
+{
+	struct iavf_rx_buffer *bi;
+	struct iavf_ring *rx_ring;
+	u64 hr, mask;
+	u16 nta;
+
+	rx_ring = container_of(alloc, struct iavf_ring, zca);
+	hr = rx_ring->xsk_pool->headroom + XDP_PACKET_HEADROOM;
+	mask = rx_ring->xsk_pool->chunk_mask;
+
+	nta = rx_ring->next_to_alloc;
+	bi = &rx_ring->rx_bi[nta];
+
+	nta++;
+	rx_ring->next_to_alloc = (nta < rx_ring->count) ? nta : 0;
+
+	handle &= mask;
+
+	bi->dma = xdp_umem_get_dma(rx_ring->xsk_pool, handle);
+	bi->dma += hr;
+
+	bi->addr = xdp_umem_get_data(rx_ring->xsk_pool, handle);
+	bi->addr += hr;
+
+	bi->handle = (u64)handle + rx_ring->xsk_pool->headroom;
+}
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+/**
+ * iavf_construct_skb_zc - Create skb from zero-copy Rx buffer
+ * @rx_ring: Rx ring
+ * @bi: Rx buffer
+ * @xdp: xdp_buff
+ *
+ * This functions allocates a new skb from a zero-copy Rx buffer.
+ *
+ * Returns the skb, or NULL on failure.
+ **/
+static struct sk_buff *iavf_construct_skb_zc(struct iavf_ring *rx_ring,
+					     struct iavf_rx_buffer *bi,
+					     struct xdp_buff *xdp)
+{
+	unsigned int metasize = xdp->data - xdp->data_meta;
+	unsigned int datasize = xdp->data_end - xdp->data;
+	struct sk_buff *skb;
+
+	/* allocate a skb to store the frags */
+	skb = __napi_alloc_skb(&rx_ring->q_vector->napi,
+			       xdp->data_end - xdp->data_hard_start,
+			       GFP_ATOMIC | __GFP_NOWARN);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reserve(skb, xdp->data - xdp->data_hard_start);
+	memcpy(__skb_put(skb, datasize), xdp->data, datasize);
+	if (metasize)
+		skb_metadata_set(skb, metasize);
+
+	iavf_reuse_rx_buffer_zc(rx_ring, bi);
+	return skb;
+}
+
+/**
+ * iavf_inc_ntc - Advance the next_to_clean index
+ * @rx_ring: Rx ring
+ **/
+static void iavf_inc_ntc(struct iavf_ring *rx_ring)
+{
+	u32 ntc = rx_ring->next_to_clean + 1;
+
+	ntc = (ntc < rx_ring->count) ? ntc : 0;
+	rx_ring->next_to_clean = ntc;
+	prefetch(IAVF_RX_DESC(rx_ring, ntc));
+}
+
+/**
+ * iavf_run_xdp_zc - Executes an XDP program on a zero-copy xdp_buff
+ * @rx_ring: Rx ring
+ * @xdp: xdp_buff used as input to the XDP program
+ *
+ * Returns any of IAVF_XDP_{PASS, CONSUMED, TX, REDIR}
+ **/
+static int iavf_run_xdp_zc(struct iavf_ring *rx_ring, struct xdp_buff *xdp)
+{
+	int err, result = IAVF_XDP_PASS;
+	struct iavf_ring *xdp_ring;
+	struct bpf_prog *xdp_prog;
+	u32 act;
+
+	rcu_read_lock();
+	/* the program is only gone here while the rings are being torn down
+	 * after it was removed, hand those last frames to the stack
+	 */
+	xdp_prog = READ_ONCE(rx_ring->xdp_prog);
+	if (unlikely(!xdp_prog))
+		goto xdp_out;
+
+	act = bpf_prog_run_xdp(xdp_prog, xdp);
+#ifndef HAVE_NETDEV_BPF_XSK_POOL
+	xdp->handle += xdp->data - xdp->data_hard_start;
+#endif /* !HAVE_NETDEV_BPF_XSK_POOL */
+	switch (act) {
+	case XDP_PASS:
+		break;
+	case XDP_TX:
+		xdp_ring = rx_ring->vsi->xdp_rings[rx_ring->queue_index];
+		result = iavf_xmit_xdp_tx_ring_zc(xdp, xdp_ring);
+		break;
+	case XDP_REDIRECT:
+		err = xdp_do_redirect(rx_ring->netdev, xdp, xdp_prog);
+		result = !err ? IAVF_XDP_REDIR : IAVF_XDP_CONSUMED;
+		break;
+	default:
+		bpf_warn_invalid_xdp_action(rx_ring->netdev, xdp_prog, act);
+		/* fall through */
+	case XDP_ABORTED:
+		trace_xdp_exception(rx_ring->netdev, xdp_prog, act);
+		/* fall through -- handle aborts by dropping packet */
+	case XDP_DROP:
+		result = IAVF_XDP_CONSUMED;
+		break;
+	}
+xdp_out:
+	rcu_read_unlock();
+	return result;
+}
+
+/**
+ * iavf_clean_rx_irq_zc - Consumes Rx packets from the hardware ring
+ * @rx_ring: Rx ring
+ * @budget: NAPI budget
+ *
+ * Returns amount of work completed
+ **/
+int iavf_clean_rx_irq_zc(struct iavf_ring *rx_ring, int budget)
+{
+	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
+	u16 cleaned_count = IAVF_DESC_UNUSED(rx_ring);
+	unsigned int xdp_res, xdp_xmit = 0;
+	bool failure = false;
+	struct sk_buff *skb;
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+	struct xdp_buff *xdp;
+#else
+	struct xdp_buff xdp_umem, *xdp = &xdp_umem;
+
+	xdp->rxq = &rx_ring->xdp_rxq;
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+	while (likely(total_rx_packets < (unsigned int)budget)) {
+		struct iavf_rx_buffer *bi;
+		union iavf_rx_desc *rx_desc;
+		unsigned int size;
+		u16 vlan_tag;
+		u8 rx_ptype;
+		u64 qword;
+
+		if (cleaned_count >= IAVF_RX_BUFFER_WRITE) {
+			failure = failure ||
+				  iavf_alloc_rx_buffers_fast_zc(rx_ring,
+								cleaned_count);
+			cleaned_count = 0;
+		}
+
+		rx_desc = IAVF_RX_DESC(rx_ring, rx_ring->next_to_clean);
+		qword = le64_to_cpu(rx_desc->wb.qword1.status_error_len);
+
+		/* This memory barrier is needed to keep us from reading
+		 * any other fields out of the rx_desc until we have
+		 * verified the descriptor has been written back.
+		 */
+		dma_rmb();
+
+		if (!iavf_test_staterr(rx_desc,
+				       BIT(IAVF_RX_DESC_STATUS_DD_SHIFT)))
+			break;
+
+		size = (qword & IAVF_RXD_QW1_LENGTH_PBUF_MASK) >>
+		       IAVF_RXD_QW1_LENGTH_PBUF_SHIFT;
+		if (!size)
+			break;
+
+		bi = iavf_get_rx_buffer_zc(rx_ring, size);
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+		xdp = bi->xdp;
+#else
+		xdp->data = bi->addr;
+		xdp->data_meta = xdp->data;
+		xdp->data_hard_start = xdp->data - XDP_PACKET_HEADROOM;
+		xdp->data_end = xdp->data + size;
+		xdp->handle = bi->handle;
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+		xdp_res = iavf_run_xdp_zc(rx_ring, xdp);
+		if (xdp_res) {
+			if (xdp_res & (IAVF_XDP_TX | IAVF_XDP_REDIR)) {
+				xdp_xmit |= xdp_res;
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+				bi->xdp = NULL;
+#else
+				bi->addr = NULL;
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+			} else {
+				iavf_reuse_rx_buffer_zc(rx_ring, bi);
+			}
+
+			total_rx_bytes += size;
+			total_rx_packets++;
+
+			cleaned_count++;
+			iavf_inc_ntc(rx_ring);
+			continue;
+		}
+
+		/* XDP_PASS path, the frame is copied out of the umem so the
+		 * chunk can go straight back to the hardware
+		 */
+		skb = iavf_construct_skb_zc(rx_ring, bi, xdp);
+		if (!skb) {
+			rx_ring->rx_stats.alloc_buff_failed++;
+			break;
+		}
+
+		cleaned_count++;
+		iavf_inc_ntc(rx_ring);
+
+		if (eth_skb_pad(skb))
+			continue;
+
+		total_rx_bytes += skb->len;
+		total_rx_packets++;
+
+		rx_ptype = (qword & IAVF_RXD_QW1_PTYPE_MASK) >>
+			   IAVF_RXD_QW1_PTYPE_SHIFT;
+		iavf_process_skb_fields(rx_ring, rx_desc, skb, rx_ptype);
+
+		vlan_tag = (qword & BIT(IAVF_RX_DESC_STATUS_L2TAG1P_SHIFT)) ?
+			   le16_to_cpu(rx_desc->wb.qword0.lo_dword.l2tag1) : 0;
+		iavf_receive_skb(rx_ring, skb, vlan_tag);
+	}
+
+	if (xdp_xmit & IAVF_XDP_REDIR)
+		xdp_do_flush_map();
+
+	if (xdp_xmit & IAVF_XDP_TX)
+		iavf_xdp_ring_update_tail(rx_ring->vsi->xdp_rings[rx_ring->queue_index]);
+
+	u64_stats_update_begin(&rx_ring->syncp);
+	rx_ring->stats.packets += total_rx_packets;
+	rx_ring->stats.bytes += total_rx_bytes;
+	u64_stats_update_end(&rx_ring->syncp);
+	rx_ring->q_vector->rx.total_packets += total_rx_packets;
+	rx_ring->q_vector->rx.total_bytes += total_rx_bytes;
+
+#ifdef HAVE_NDO_XSK_WAKEUP
+	if (xsk_uses_need_wakeup(rx_ring->xsk_pool)) {
+		if (failure || rx_ring->next_to_clean == rx_ring->next_to_use)
+			xsk_set_rx_need_wakeup(rx_ring->xsk_pool);
+		else
+			xsk_clear_rx_need_wakeup(rx_ring->xsk_pool);
+
+		return (int)total_rx_packets;
+	}
+
+#endif /* HAVE_NDO_XSK_WAKEUP */
+	/* guarantee a trip back through this routine if there was a failure */
+	return failure ? budget : (int)total_rx_packets;
+}
+
+/**
+ * iavf_xsk_clean_rx_ring - Hand the Rx buffers back to the pool
+ * @rx_ring: Rx ring
+ **/
+void iavf_xsk_clean_rx_ring(struct iavf_ring *rx_ring)
+{
+	u16 i;
+
+	for (i = 0; i < rx_ring->count; i++) {
+		struct iavf_rx_buffer *rx_bi = &rx_ring->rx_bi[i];
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+		if (!rx_bi->xdp)
+			continue;
+
+		xsk_buff_free(rx_bi->xdp);
+		rx_bi->xdp = NULL;
+#else
+		if (!rx_bi->addr)
+			continue;
+
+		xsk_umem_fq_reuse(rx_ring->xsk_pool, rx_bi->handle);
+		rx_bi->addr = NULL;
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+	}
+}
+
+/**
+ * iavf_xmit_zc - Performs zero-copy Tx AF_XDP
+ * @xdp_ring: XDP Tx ring
+ * @budget: NAPI budget
+ *
+ * Only the last descriptor of a batch asks for a write-back, the first
+ * buffer of the batch watches it so the batch is completed in one go.
+ *
+ * Returns true if the work is finished.
+ **/
+static bool iavf_xmit_zc(struct iavf_ring *xdp_ring, unsigned int budget)
+{
+	struct iavf_tx_buffer *first = NULL, *tx_bi;
+	struct iavf_tx_desc *tx_desc = NULL;
+	bool work_done = true;
+#ifdef XSK_UMEM_RETURNS_XDP_DESC
+	struct xdp_desc desc;
+#endif
+	dma_addr_t dma;
+	u32 len;
+
+	while (budget-- > 0) {
+		if (!unlikely(IAVF_DESC_UNUSED(xdp_ring))) {
+			xdp_ring->tx_stats.tx_busy++;
+			work_done = false;
+			break;
+		}
+
+#ifdef XSK_UMEM_RETURNS_XDP_DESC
+		if (!xsk_tx_peek_desc(xdp_ring->xsk_pool, &desc))
+			break;
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+		dma = xsk_buff_raw_get_dma(xdp_ring->xsk_pool, desc.addr);
+#else
+		dma = xdp_umem_get_dma(xdp_ring->xsk_pool, desc.addr);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+		len = desc.len;
+#else
+		if (!xsk_umem_consume_tx(xdp_ring->xsk_pool, &dma, &len))
+			break;
+#endif /* XSK_UMEM_RETURNS_XDP_DESC */
+
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+		xsk_buff_raw_dma_sync_for_device(xdp_ring->xsk_pool, dma, len);
+#else
+		dma_sync_single_for_device(xdp_ring->dev, dma, len,
+					   DMA_BIDIRECTIONAL);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+
+		tx_bi = &xdp_ring->tx_bi[xdp_ring->next_to_use];
+		tx_bi->bytecount = len;
+		tx_bi->gso_segs = 1;
+		tx_bi->xdpf = NULL;
+		if (!first)
+			first = tx_bi;
+
+		tx_desc = IAVF_TX_DESC(xdp_ring, xdp_ring->next_to_use);
+		tx_desc->buffer_addr = cpu_to_le64(dma);
+		tx_desc->cmd_type_offset_bsz =
+			build_ctob(IAVF_TX_DESC_CMD_ICRC | IAVF_TX_DESC_CMD_EOP,
+				   0, len, 0);
+
+		xdp_ring->next_to_use++;
+		if (xdp_ring->next_to_use == xdp_ring->count)
+			xdp_ring->next_to_use = 0;
+	}
+
+	if (tx_desc) {
+		/* Request a write-back for the last frame and bump tail */
+		tx_desc->cmd_type_offset_bsz |=
+			cpu_to_le64((u64)IAVF_TX_DESC_CMD_RS <<
+				    IAVF_TXD_QW1_CMD_SHIFT);
+
+		/* Make certain all of the status bits have been updated
+		 * before next_to_watch is written.
+		 */
+		smp_wmb();
+		first->next_to_watch = tx_desc;
+
+		iavf_xdp_ring_update_tail(xdp_ring);
+		xsk_tx_release(xdp_ring->xsk_pool);
+	}
+
+	return !!budget && work_done;
+}
+
+/**
+ * iavf_clean_xdp_tx_buffer - Frees and unmaps an XDP_TX buffer
+ * @tx_ring: XDP Tx ring
+ * @tx_bi: Tx buffer info to clean
+ **/
+static void iavf_clean_xdp_tx_buffer(struct iavf_ring *tx_ring,
+				     struct iavf_tx_buffer *tx_bi)
+{
+	xdp_return_frame(tx_bi->xdpf);
+	tx_bi->xdpf = NULL;
+	dma_unmap_single(tx_ring->dev,
+			 dma_unmap_addr(tx_bi, dma),
+			 dma_unmap_len(tx_bi, len), DMA_TO_DEVICE);
+	dma_unmap_len_set(tx_bi, len, 0);
+}
+
+/**
+ * iavf_clean_xdp_tx_irq - Completes AF_XDP entries, and cleans XDP entries
+ * @vsi: the VSI we care about
+ * @tx_ring: XDP Tx ring
+ *
+ * The ring carries both XDP_TX frames, each with its own write-back, and
+ * AF_XDP batches, see iavf_xmit_zc.
+ *
+ * Returns true if cleanup/tranmission is done.
+ **/
+bool iavf_clean_xdp_tx_irq(struct iavf_vsi *vsi, struct iavf_ring *tx_ring)
+{
+	unsigned int total_bytes = 0, total_packets = 0;
+	struct xsk_buff_pool *pool = tx_ring->xsk_pool;
+	unsigned int budget = tx_ring->work_limit;
+	u16 ntc = tx_ring->next_to_clean;
+	struct iavf_tx_desc *tx_head = NULL;
+	struct iavf_tx_buffer *tx_bi;
+	u32 xsk_frames = 0;
+	bool xmit_done;
+
+	if (ring_uses_head_wb(tx_ring))
+		tx_head = IAVF_TX_DESC(tx_ring, iavf_get_head(tx_ring));
+
+	while (budget) {
+		struct iavf_tx_desc *eop_desc, *tx_desc;
+
+		tx_bi = &tx_ring->tx_bi[ntc];
+		eop_desc = tx_bi->next_to_watch;
+
+		/* if next_to_watch is not set then there is no work pending */
+		if (!eop_desc)
+			break;
+
+		/* prevent any other reads prior to eop_desc */
+		read_barrier_depends();
+
+		/* if the packet isn't done, no work yet to do */
+		if (!iavf_tx_done(tx_ring, &tx_head,
+				  IAVF_TX_DESC(tx_ring, ntc), eop_desc))
+			break;
+
+		/* clear next_to_watch to prevent false hangs */
+		tx_bi->next_to_watch = NULL;
+
+		do {
+			tx_bi = &tx_ring->tx_bi[ntc];
+			tx_desc = IAVF_TX_DESC(tx_ring, ntc);
+
+			total_bytes += tx_bi->bytecount;
+			total_packets++;
+
+			if (tx_bi->xdpf)
+				iavf_clean_xdp_tx_buffer(tx_ring, tx_bi);
+			else
+				xsk_frames++;
+
+			ntc++;
+			if (ntc == tx_ring->count)
+				ntc = 0;
+		} while (tx_desc != eop_desc);
+
+		budget--;
+	}
+
+	tx_ring->next_to_clean = ntc;
+
+	u64_stats_update_begin(&tx_ring->syncp);
+	tx_ring->stats.bytes += total_bytes;
+	tx_ring->stats.packets += total_packets;
+	u64_stats_update_end(&tx_ring->syncp);
+	tx_ring->q_vector->tx.total_bytes += total_bytes;
+	tx_ring->q_vector->tx.total_packets += total_packets;
+
+	if (xsk_frames)
+		xsk_tx_completed(pool, xsk_frames);
+
+#ifdef HAVE_NDO_XSK_WAKEUP
+	if (xsk_uses_need_wakeup(pool))
+		xsk_set_tx_need_wakeup(pool);
+
+#endif /* HAVE_NDO_XSK_WAKEUP */
+	xmit_done = iavf_xmit_zc(tx_ring, tx_ring->work_limit);
+
+	return budget > 0 && xmit_done;
+}
+
+/**
+ * iavf_xsk_clean_tx_ring - Clean the XDP Tx ring on shutdown
+ * @tx_ring: XDP Tx ring
+ **/
+void iavf_xsk_clean_tx_ring(struct iavf_ring *tx_ring)
+{
+	u16 ntc = tx_ring->next_to_clean, ntu = tx_ring->next_to_use;
+	struct xsk_buff_pool *pool = tx_ring->xsk_pool;
+	struct iavf_tx_buffer *tx_bi;
+	u32 xsk_frames = 0;
+
+	while (ntc != ntu) {
+		tx_bi = &tx_ring->tx_bi[ntc];
+
+		if (tx_bi->xdpf)
+			iavf_clean_xdp_tx_buffer(tx_ring, tx_bi);
+		else
+			xsk_frames++;
+
+		tx_bi->next_to_watch = NULL;
+
+		ntc++;
+		if (ntc == tx_ring->count)
+			ntc = 0;
+	}
+
+	if (xsk_frames)
+		xsk_tx_completed(pool, xsk_frames);
+}
+
+/**
+ * iavf_xsk_wakeup - Implements the ndo_xsk_wakeup
+ * @netdev: netdevice
+ * @queue_id: queue to wake up
+ * @flags: ignored in our case since we have Rx and Tx in the same NAPI
+ *
+ * Returns <0 for errors, 0 otherwise.
+ **/
+#ifdef HAVE_NDO_XSK_WAKEUP
+int iavf_xsk_wakeup(struct net_device *netdev, u32 queue_id,
+		    u32 __always_unused flags)
+#else
+int iavf_xsk_async_xmit(struct net_device *netdev, u32 queue_id)
+#endif /* HAVE_NDO_XSK_WAKEUP */
+{
+	struct iavf_adapter *adapter = netdev_priv(netdev);
+	struct iavf_vsi *vsi = &adapter->vsi;
+	struct iavf_ring *ring;
+
+	if (test_bit(__IAVF_VSI_DOWN, vsi->state))
+		return -ENETDOWN;
+
+	if (!vsi->xdp_prog || !vsi->xdp_rings)
+		return -ENXIO;
+
+	if (queue_id >= adapter->num_xdp_queues)
+		return -ENXIO;
+
+	ring = vsi->xdp_rings[queue_id];
+	if (!ring->xsk_pool)
+		return -ENXIO;
+
+	/* The idea here is that if NAPI is running, mark a miss, so
+	 * it will run again. If not, trigger an interrupt and
+	 * schedule the NAPI from interrupt context. If NAPI would be
+	 * scheduled here, the interrupt affinity would not be
+	 * honored.
+	 */
+	if (!napi_if_scheduled_mark_missed(&ring->q_vector->napi))
+		iavf_force_wb(vsi, ring->q_vector);
+
+	return 0;
+}
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
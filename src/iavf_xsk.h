@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (c) 2013, Intel Corporation. */
+
+#ifndef _IAVF_XSK_H_
+#define _IAVF_XSK_H_
+
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+struct iavf_adapter;
+struct iavf_vsi;
+struct iavf_ring;
+struct xsk_buff_pool;
+
+struct xsk_buff_pool *iavf_xsk_pool(struct iavf_adapter *adapter, u16 qid);
+#ifdef HAVE_NETDEV_BPF_XSK_POOL
+int iavf_xsk_pool_setup(struct iavf_adapter *adapter,
+			struct xsk_buff_pool *pool, u16 qid);
+#else
+struct xdp_umem;
+struct zero_copy_allocator;
+
+#ifndef NO_XDP_QUERY_XSK_UMEM
+int iavf_xsk_umem_query(struct iavf_adapter *adapter, struct xdp_umem **umem,
+			u16 qid);
+#endif /* NO_XDP_QUERY_XSK_UMEM */
+int iavf_xsk_umem_setup(struct iavf_adapter *adapter, struct xdp_umem *umem,
+			u16 qid);
+void iavf_zca_free(struct zero_copy_allocator *alloc, unsigned long handle);
+#endif /* HAVE_NETDEV_BPF_XSK_POOL */
+void iavf_xsk_configure_rx_ring(struct iavf_ring *rx_ring);
+
+bool iavf_alloc_rx_buffers_zc(struct iavf_ring *rx_ring, u16 cleaned_count);
+int iavf_clean_rx_irq_zc(struct iavf_ring *rx_ring, int budget);
+void iavf_xsk_clean_rx_ring(struct iavf_ring *rx_ring);
+
+bool iavf_clean_xdp_tx_irq(struct iavf_vsi *vsi, struct iavf_ring *tx_ring);
+void iavf_xsk_clean_tx_ring(struct iavf_ring *tx_ring);
+#ifdef HAVE_NDO_XSK_WAKEUP
+int iavf_xsk_wakeup(struct net_device *netdev, u32 queue_id, u32 flags);
+#else
+int iavf_xsk_async_xmit(struct net_device *netdev, u32 queue_id);
+#endif /* HAVE_NDO_XSK_WAKEUP */
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+#endif /* _IAVF_XSK_H_ */
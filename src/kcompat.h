@@ -5611,6 +5611,7 @@ unsigned int _kc_cpumask_local_spread(unsigned int i, int node);
 #define HAVE_PASSTHRU_FEATURES_CHECK
 #define HAVE_NDO_SET_VF_RSS_QUERY_EN
 #define HAVE_NDO_SET_TX_MAXRATE
+#define HAVE_SK_FULLSOCK
 #endif /* 4,1,0 */
 
 /*****************************************************************************/
@@ -6627,6 +6628,7 @@ _kc_devlink_port_attrs_set(struct devlink_port *devlink_port,
 #define HAVE_NDO_XDP_XMIT_BULK_AND_FLAGS
 #define NO_NDO_XDP_FLUSH
 #define HAVE_AF_XDP_SUPPORT
+#define HAVE_SK_RX_QUEUE_GET
 #endif /* 4.18.0 */
 
 /*****************************************************************************/
@@ -6671,6 +6673,7 @@ _kc_devlink_port_attrs_set(struct devlink_port *devlink_port,
 #define HAVE_RHASHTABLE_TYPES
 #define HAVE_DEVLINK_REGIONS
 #define HAVE_DEVLINK_PARAMS
+#define HAVE_NETIF_RECEIVE_SKB_LIST
 #endif /* 4.19.0 */
 
 /*****************************************************************************/
@@ -7007,6 +7010,9 @@ devlink_flash_update_status_notify(struct devlink __always_unused *devlink,
 #define XSK_UMEM_RETURNS_XDP_DESC
 #define HAVE_XSK_UMEM_HAS_ADDRS
 #define HAVE_FLOW_BLOCK_API
+#if IS_ENABLED(CONFIG_DIMLIB)
+#define HAVE_DIM
+#endif /* CONFIG_DIMLIB */
 #endif /* 5.3.0 */
 
 /*****************************************************************************/
@@ -7066,6 +7072,7 @@ static inline void _kc_bitmap_set_value8(unsigned long *map,
 #endif /* HAVE_AF_XDP_SUPPORT */
 #else /* >= 5.6.0 */
 #define HAVE_TX_TIMEOUT_TXQUEUE
+#define HAVE_HK_FLAG_MANAGED_IRQ
 #endif /* 5.6.0 */
 
 /*****************************************************************************/
@@ -7114,6 +7121,92 @@ _kc_devlink_region_create(struct devlink *devlink,
 #define xdp_convert_buff_to_frame convert_to_xdp_frame
 #else /* >= 5.8.0 */
 #undef HAVE_AF_XDP_ZC_SUPPORT
+#define HAVE_XDP_BUFF_FRAME_SZ
 #endif /* 5.8.0 */
 
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5,9,0))
+#define HAVE_XDP_QUERY_PROG
+#endif /* 5.9.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5,10,0))
+#ifdef HAVE_AF_XDP_ZC_SUPPORT
+/* the umem is the buffer pool of the older AF_XDP API */
+#define xsk_buff_pool			xdp_umem
+#define xsk_tx_peek_desc		xsk_umem_consume_tx
+#define xsk_tx_release			xsk_umem_consume_tx_done
+#define xsk_tx_completed		xsk_umem_complete_tx
+#define xsk_uses_need_wakeup		xsk_umem_uses_need_wakeup
+#endif /* HAVE_AF_XDP_ZC_SUPPORT */
+#else /* >= 5.10.0 */
+#define HAVE_AF_XDP_ZC_SUPPORT
+#define HAVE_NETDEV_BPF_XSK_POOL
+#endif /* 5.10.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5,11,0))
+#define HAVE_XDP_RXQ_INFO_REG_3_PARAMS
+#else /* >= 5.11.0 */
+#define HAVE_XDP_FRAME_BULK
+#endif /* 5.11.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5,12,0))
+#ifdef HAVE_XDP_FRAME_BULK
+#include <net/xdp.h>
+static inline void _kc_xdp_frame_bulk_init(struct xdp_frame_bulk *bq)
+{
+	bq->xa = NULL;
+}
+
+#define xdp_frame_bulk_init _kc_xdp_frame_bulk_init
+#endif /* HAVE_XDP_FRAME_BULK */
+#else /* >= 5.12.0 */
+#define HAVE_NAPI_THREADED
+#endif /* 5.12.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,13,0))
+/* ndo_xdp_xmit callers free the frames the driver didn't queue */
+#define HAVE_XDP_XMIT_CORE_DROP
+#endif /* 5.13.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,14,0))
+#define HAVE_ALLOC_PAGES_BULK
+#endif /* 5.14.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,15,0))
+#define HAVE_SKB_MARK_FOR_RECYCLE
+#define HAVE_NDO_ETH_IOCTL
+/* page_pool Rx relies on skbs recycling their pages back to the pool */
+#if IS_ENABLED(CONFIG_PAGE_POOL)
+#define HAVE_PAGE_POOL
+#endif /* CONFIG_PAGE_POOL */
+#endif /* 5.15.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5,17,0))
+#ifdef HAVE_XDP_SUPPORT
+#include <linux/filter.h>
+static inline void
+_kc_bpf_warn_invalid_xdp_action(struct net_device __always_unused *dev,
+				struct bpf_prog __always_unused *prog, u32 act)
+{
+	bpf_warn_invalid_xdp_action(act);
+}
+
+#define bpf_warn_invalid_xdp_action(dev, prog, act) \
+	_kc_bpf_warn_invalid_xdp_action(dev, prog, act)
+#endif /* HAVE_XDP_SUPPORT */
+#endif /* 5.17.0 */
+
+/*****************************************************************************/
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,18,0))
+/* housekeeping_cpumask() takes an enum hk_type, the HK_FLAG_* are gone */
+#define HK_FLAG_MANAGED_IRQ HK_TYPE_MANAGED_IRQ
+#endif /* 5.18.0 */
+
 #endif /* _KCOMPAT_H_ */
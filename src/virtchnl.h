@@ -246,8 +246,9 @@ VIRTCHNL_CHECK_STRUCT_LEN(16, virtchnl_vsi_resource);
 #define VIRTCHNL_VF_OFFLOAD_ADQ			0X00800000
 #define VIRTCHNL_VF_OFFLOAD_ADQ_V2		0X01000000
 #define VIRTCHNL_VF_OFFLOAD_USO			0X02000000
+#define VIRTCHNL_VF_OFFLOAD_RX_FLEX_DESC	0X04000000
 	/* 0X40000000 is reserved */
-	/* 0X04000000, 0X08000000 and 0X10000000 are reserved */
+	/* 0X08000000 and 0X10000000 are reserved */
 	/* 0X80000000 is reserved */
 
 /* Define below the capability flags that are not offloads */
@@ -299,8 +300,16 @@ VIRTCHNL_CHECK_STRUCT_LEN(24, virtchnl_txq_info);
  * offload must have been set prior to sending this info or the PF
  * will ignore the request. This flag should be set the same for
  * all of the queues for a VF.
+ *
+ * The rxdid field selects the Rx descriptor format of the queue. It is only
+ * looked at when VIRTCHNL_VF_OFFLOAD_RX_FLEX_DESC has been negotiated,
+ * otherwise the PF uses 32-byte descriptors.
  */
 
+/* Rx descriptor IDs */
+#define VIRTCHNL_RXDID_0_16B_BASE	0
+#define VIRTCHNL_RXDID_1_32B_BASE	1
+
 /* Rx queue config info */
 struct virtchnl_rxq_info {
 	u16 vsi_id;
@@ -311,7 +320,8 @@ struct virtchnl_rxq_info {
 	u32 databuffer_size;
 	u32 max_pkt_size;
 	u8 crc_disable;
-	u8 pad1[3];
+	u8 rxdid;
+	u8 pad1[2];
 	u64 dma_ring_addr;
 	enum virtchnl_rx_hsplit rx_split_pos; /* deprecated with AVF 1.0 */
 	u32 pad2;